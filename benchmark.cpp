@@ -0,0 +1,196 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <logger.hpp>
+
+using namespace markusjx::logging;
+
+namespace {
+    // The stringstream based formatter the logger used before switching to std::to_chars,
+    // kept here as a reference to compare the current implementation against
+    void legacyFormatOption(std::stringstream &ss, char option, const char *file, int line, const char *method,
+                            const char *logLevel, const std::string &message) {
+        switch (option) {
+            case 't':
+                ss << LoggerUtils::currentDateTime();
+                break;
+            case 'f':
+                ss << file;
+                break;
+            case 'l':
+                ss << line;
+                break;
+            case 'M':
+                ss << method;
+                break;
+            case 'p':
+                ss << logLevel;
+                break;
+            case 'm':
+                ss << message;
+                break;
+            case 'n':
+                ss << std::endl;
+                break;
+            case '%':
+                ss << '%';
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::string legacyFormatMessage(const char *file, int line, const char *method, const char *logLevel,
+                                    const std::string &message) {
+        std::stringstream ss;
+        const std::string format(LoggerOptions::log_fmt);
+
+        size_t last = 0;
+        while (last < std::string::npos) {
+            size_t pos = format.find('%', last);
+            if (pos == std::string::npos) {
+                ss << format.substr(last);
+                break;
+            } else {
+                ss << format.substr(last, pos - last);
+
+                legacyFormatOption(ss, format[pos + 1], file, line, method, logLevel, message);
+                last = pos + 2;
+            }
+        }
+
+        return ss.str();
+    }
+
+    template<class...Args>
+    std::string legacyFormat(const char *fmt, Args...args) {
+        int size = snprintf(nullptr, 0, fmt, args...);
+        std::string out(size + 1, '\0');
+
+        snprintf(out.data(), out.size(), fmt, args...);
+        out.resize(strlen(out.c_str()));
+        return out;
+    }
+
+    /**
+     * Keep the compiler from removing a computation or hoisting
+     * loads of memory it cannot see being changed out of a loop
+     */
+    template<class T>
+    void doNotOptimize(T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r"(&value) : "memory");
+#else
+        static volatile const void *escaped;
+        escaped = &value;
+#endif
+    }
+
+    template<class Func>
+    void run(const char *name, size_t iterations, Func &&func) {
+        size_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            sink += func(i);
+            doNotOptimize(sink);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+        std::cout << name << ": " << ns << " ns/op (" << sink << " bytes)" << std::endl;
+    }
+}
+
+int main() {
+    constexpr size_t iterations = 1000000;
+    LoggerOptions::setLogFormat("[%t] [%f:%l] [%M] [%p] %m (%l) %n");
+
+    run("formatMessage (legacy)", iterations, [](size_t i) {
+        return legacyFormatMessage("benchmark.cpp", static_cast<int>(i), "main", "DEBUG", "value").size();
+    });
+    run("formatMessage", iterations, [](size_t i) {
+        return LoggerOptions::formatMessage("benchmark.cpp", static_cast<int>(i), "main", "DEBUG", "value").size();
+    });
+
+    run("printf formatting (legacy)", iterations, [](size_t i) {
+        return legacyFormat("id=%zu count=%d ratio=%f", i, static_cast<int>(i * 3), i / 7.0).size();
+    });
+    run("printf formatting", iterations, [](size_t i) {
+        return LoggerUtils::format("id=%zu count=%d ratio=%f", i, static_cast<int>(i * 3), i / 7.0).size();
+    });
+
+    std::string payload(1024, '\0');
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = static_cast<char>(i * 7);
+    }
+
+    // Renders the same hex dump as LoggerUtils::appendHexDump using a std::stringstream
+    const auto legacyHexDump = [&payload] {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0');
+        for (size_t i = 0; i < payload.size(); i += 16) {
+            const size_t count = std::min<size_t>(16, payload.size() - i);
+            ss << "    " << std::setw(8) << i << "  ";
+            for (size_t j = 0; j < 16; j++) {
+                if (j < count) {
+                    ss << std::setw(2) << static_cast<int>(static_cast<unsigned char>(payload[i + j])) << ' ';
+                } else {
+                    ss << "   ";
+                }
+
+                if (j == 7) ss << ' ';
+            }
+
+            ss << " |";
+            for (size_t j = 0; j < count; j++) {
+                const auto c = static_cast<unsigned char>(payload[i + j]);
+                ss << (c >= 0x20 && c < 0x7f ? static_cast<char>(c) : '.');
+            }
+            ss << "|\n";
+        }
+
+        return ss.str();
+    };
+
+    std::string hexDump;
+    LoggerUtils::appendHexDump(hexDump, payload.data(), payload.size());
+    if (legacyHexDump() != hexDump) {
+        std::cerr << "The hex dumps differ, the comparison is not meaningful" << std::endl;
+    }
+
+    run("hex payload (stringstream)", iterations / 100, [&legacyHexDump](size_t) {
+        return legacyHexDump().size();
+    });
+    run("hex payload", iterations / 100, [&payload](size_t) {
+        std::string out;
+        LoggerUtils::appendHexDump(out, payload.data(), payload.size());
+        return out.size();
+    });
+    run("base64 payload", iterations / 100, [&payload](size_t) {
+        std::string out;
+        LoggerUtils::appendBase64(out, payload.data(), payload.size());
+        return out.size();
+    });
+
+    // Messages below the log level of the logger should cost close to nothing. The level is
+    // only known at runtime, so the level checks cannot be folded away when they are inlined
+    volatile LogLevel filteredLevel = WARNING;
+    Logger logger(MODE_CONSOLE, filteredLevel, SYNC);
+    run("filtered debug", iterations, [&logger](size_t) {
+        logger.debug("A filtered debug message which is never written");
+        return 0;
+    });
+    run("filtered debugf", iterations, [&logger](size_t i) {
+        logger.debugf("A filtered debug message: %zu", i);
+        return 0;
+    });
+
+    StaticLogger::create(MODE_CONSOLE, filteredLevel, SYNC);
+    run("filtered static debug", iterations, [](size_t) {
+        StaticLogger::debug("A filtered debug message which is never written");
+        return 0;
+    });
+
+    return 0;
+}
@@ -28,11 +28,22 @@
 #include <functional>
 #include <sstream>
 #include <ctime>
+#include <chrono>
 #include <mutex>
 #include <cstring>
 #include <memory>
 #include <thread>
 #include <deque>
+#include <vector>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Get the category with the given name. The category is looked up once per call site.
+#define LOGGER_CATEGORY(name) ([]() -> ::markusjx::logging::LogCategory & { \
+    static ::markusjx::logging::LogCategory &category = ::markusjx::logging::LogCategory::get(name); \
+    return category; \
+}())
 
 #ifdef LOGGER_UNIQUE_DEF
 // Write a debug message. Must be called on a logger object or the StaticLogger class.
@@ -55,6 +66,32 @@
 #define logger_warningStream _warningStream(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__)
 // Get the error stream. Must be called on a logger object or the StaticLogger class.
 #define logger_errorStream _errorStream(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__)
+
+// Write a debug message to a named category. Must be called on a logger object or the StaticLogger class.
+#define logger_debugc(category, message) _debug(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, message)
+// Write a warning message to a named category. Must be called on a logger object or the StaticLogger class.
+#define logger_warningc(category, message) _warning(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, message)
+// Write an error message to a named category. Must be called on a logger object or the StaticLogger class.
+#define logger_errorc(category, ...) _error(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
+
+// Write a formatted debug message to a named category. Must be called on a logger object or the StaticLogger class.
+#define logger_debugcf(category, fmt, ...) _debugf(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, fmt, __VA_ARGS__)
+// Write a formatted warning message to a named category. Must be called on a logger object or the StaticLogger class.
+#define logger_warningcf(category, fmt, ...) _warningf(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, fmt, __VA_ARGS__)
+// Write a formatted error message to a named category. Must be called on a logger object or the StaticLogger class.
+#define logger_errorcf(category, fmt, ...) _errorf(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, fmt, __VA_ARGS__)
+
+// Start a trace span which ends when the returned object is destroyed.
+// Must be called on a logger object or the StaticLogger class.
+#define logger_traceSpan(name) _traceSpan(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, name)
+
+// Write a debug message followed by a binary payload. Usage: debugPayload("Frame", data, size[, PAYLOAD_BASE64]).
+// Must be called on a logger object or the StaticLogger class.
+#define logger_debugPayload(...) _debugPayload(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
+// Write a warning message followed by a binary payload. Must be called on a logger object or the StaticLogger class.
+#define logger_warningPayload(...) _warningPayload(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
+// Write an error message followed by a binary payload. Must be called on a logger object or the StaticLogger class.
+#define logger_errorPayload(...) _errorPayload(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
 #else //LOGER_UNIQUE_DEF
 // Write a debug message. Must be called on a logger object or the StaticLogger class.
 #define debug(message) _debug(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, message)
@@ -76,6 +113,32 @@
 #define warningStream _warningStream(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__)
 // Get the error stream. Must be called on a logger object or the StaticLogger class.
 #define errorStream _errorStream(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__)
+
+// Write a debug message to a named category. Must be called on a logger object or the StaticLogger class.
+#define debugc(category, message) _debug(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, message)
+// Write a warning message to a named category. Must be called on a logger object or the StaticLogger class.
+#define warningc(category, message) _warning(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, message)
+// Write an error message to a named category. Must be called on a logger object or the StaticLogger class.
+#define errorc(category, ...) _error(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
+
+// Write a formatted debug message to a named category. Must be called on a logger object or the StaticLogger class.
+#define debugcf(category, fmt, ...) _debugf(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, fmt, __VA_ARGS__)
+// Write a formatted warning message to a named category. Must be called on a logger object or the StaticLogger class.
+#define warningcf(category, fmt, ...) _warningf(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, fmt, __VA_ARGS__)
+// Write a formatted error message to a named category. Must be called on a logger object or the StaticLogger class.
+#define errorcf(category, fmt, ...) _errorf(LOGGER_CATEGORY(category), ::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, fmt, __VA_ARGS__)
+
+// Start a trace span which ends when the returned object is destroyed.
+// Must be called on a logger object or the StaticLogger class.
+#define traceSpan(name) _traceSpan(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, name)
+
+// Write a debug message followed by a binary payload. Usage: debugPayload("Frame", data, size[, PAYLOAD_BASE64]).
+// Must be called on a logger object or the StaticLogger class.
+#define debugPayload(...) _debugPayload(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
+// Write a warning message followed by a binary payload. Must be called on a logger object or the StaticLogger class.
+#define warningPayload(...) _warningPayload(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
+// Write an error message followed by a binary payload. Must be called on a logger object or the StaticLogger class.
+#define errorPayload(...) _errorPayload(::markusjx::logging::LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__)
 #endif //LOGER_UNIQUE_DEF
 
 #if __cplusplus >= 201603L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201603L)
@@ -142,6 +205,137 @@ namespace markusjx::logging {
         ASYNC = 2
     };
 
+    /**
+     * How durable the messages of a log level are once they have been written
+     */
+    enum Durability {
+        // Leave buffering to stdio and the sinks
+        DURABILITY_NONE = 0,
+        // Flush the log file and the sinks after every batch containing a message
+        DURABILITY_FLUSH = 1,
+        // Flush and fdatasync the log file and sync the sinks after every
+        // batch containing a message. Concurrent writers share one sync
+        DURABILITY_SYNC = 2
+    };
+
+    /**
+     * What an ASYNC logger does with a message if the memory budget is exhausted
+     */
+    enum BudgetPolicy {
+        // Wait until enough memory is available or the timeout expires, then drop the message
+        BUDGET_BLOCK = 0,
+        // Drop queued messages of lower levels of the same logger, then drop the message
+        BUDGET_DROP = 1,
+        // Write the message to a temporary file until the queue is drained
+        BUDGET_SPILL = 2
+    };
+
+    /**
+     * How binary payloads are written
+     */
+    enum PayloadEncoding {
+        // A hex dump with 16 bytes per line, including the offset and the printable characters
+        PAYLOAD_HEX = 0,
+        // Base64, 76 characters per line
+        PAYLOAD_BASE64 = 1
+    };
+
+    /**
+     * The output format of trace spans
+     */
+    enum TraceFormat {
+        // The Chrome trace event JSON format, viewable in chrome://tracing or Perfetto
+        TRACE_JSON = 0,
+        // A compact binary format
+        TRACE_BINARY = 1
+    };
+
+    /**
+     * The per-thread logging context: a thread name and a mapped diagnostic
+     * context (MDC) of key/value pairs, written using the %N and %X pattern
+     * fields. The context is rendered once whenever it changes, messages
+     * only keep a reference to the rendered context.
+     */
+    class LogContext {
+    public:
+        /**
+         * The rendered context of a thread
+         */
+        struct snapshot {
+            // The name of the thread, empty if no name was set
+            std::string threadName;
+            // All key/value pairs, formatted as "key=value key=value"
+            std::string values;
+        };
+
+        /**
+         * Set a value in the context of the current thread
+         *
+         * @param key the key to set
+         * @param value the value
+         */
+        static void put(const std::string &key, const std::string &value);
+
+        /**
+         * Remove a value from the context of the current thread
+         *
+         * @param key the key to remove
+         */
+        static void remove(const std::string &key);
+
+        /**
+         * Remove all values from the context of the current thread
+         */
+        LOGGER_MAYBE_UNUSED static void clear();
+
+        /**
+         * Set the name of the current thread, written using %N
+         *
+         * @param name the thread name
+         */
+        static void setThreadName(const std::string &name);
+
+        /**
+         * Get the rendered context of the current thread.
+         * Only copies a shared pointer.
+         *
+         * @return the context, null if the thread has no context
+         */
+        static std::shared_ptr<const snapshot> current();
+
+        /**
+         * Sets a value for the lifetime of this object, e.g. for one request. Usage:
+         *
+         * <code>
+         *    LogContext::Scope scope("request", requestId);
+         * </code>
+         */
+        class Scope {
+        public:
+            /**
+             * Set a value until the scope is destroyed
+             *
+             * @param key the key to set
+             * @param value the value
+             */
+            Scope(std::string key, const std::string &value);
+
+            Scope(const Scope &) = delete;
+
+            Scope &operator=(const Scope &) = delete;
+
+            /**
+             * Restore the previous value of the key
+             */
+            ~Scope();
+
+        private:
+            std::string key;
+            std::string previous;
+            bool hadPrevious;
+        };
+    };
+
     /**
      * A namespace for logging options
      */
@@ -180,10 +374,14 @@ namespace markusjx::logging {
          * @param method the function name
          * @param logLevel the log level
          * @param message the message to format
+         * @param category the name of the category of the message
+         * @param threadId the id of the thread which wrote the message. 0 for the current thread
+         * @param context the context of the thread which wrote the message. Null if it has no context
          * @return the formatted message
          */
         static std::string formatMessage(const char *file, int line, const char *method, const char *logLevel,
-                                         const std::string &message);
+                                         const std::string &message, const char *category = "",
+                                         uint32_t threadId = 0, const LogContext::snapshot *context = nullptr);
 
         /**
          * The log format.
@@ -198,10 +396,13 @@ namespace markusjx::logging {
         static loggerTimeFormat time_fmt;
 
     private:
-        static void formatOption(std::stringstream &ss, char option, const char *file, int line, const char *method,
-                                 const char *logLevel, const std::string &message);
+        static void formatOption(std::string &out, char option, const char *file, int line, const char *method,
+                                 const char *logLevel, const std::string &message, const char *category,
+                                 uint32_t threadId, const LogContext::snapshot *context);
     };
 
+    class Logger;
+
     namespace LoggerUtils {
         /**
         * Gets the current time and date. Source: https://stackoverflow.com/a/10467633
@@ -210,13 +411,195 @@ namespace markusjx::logging {
         */
         std::string currentDateTime();
 
+        /**
+         * Append the current time and date to a string.
+         * The formatted time is cached until the second changes.
+         *
+         * @param out the string to append to
+         */
+        void appendDateTime(std::string &out);
+
+        /**
+         * Append a number to a string without going through a locale-aware stream
+         *
+         * @param out the string to append to
+         * @param value the number to append
+         */
+        void appendNumber(std::string &out, long long value);
+
+        /**
+         * Append a string to a string, escaping it for use in a JSON string
+         *
+         * @param out the string to append to
+         * @param str the string to escape and append
+         */
+        void appendJsonEscaped(std::string &out, const char *str);
+
+        /**
+         * Get the id of the current process
+         *
+         * @return the process id
+         */
+        long long processId();
+
+        /**
+         * Format a string using a printf-style format string.
+         * Short messages are formatted into a stack buffer so only a single
+         * formatting pass is required.
+         *
+         * @tparam Args the argument types
+         * @param fmt the format string
+         * @param args the arguments to format
+         * @return the formatted string
+         */
+        template<class...Args>
+        std::string format(const char *fmt, Args...args) {
+            char buf[256];
+            int size = snprintf(buf, sizeof(buf), fmt, args...);
+            if (size < 0) {
+                return std::string();
+            } else if (static_cast<size_t>(size) < sizeof(buf)) {
+                return std::string(buf, size);
+            }
+
+            std::string out(size + 1, '\0');
+            snprintf(out.data(), out.size(), fmt, args...);
+            out.resize(size);
+            return out;
+        }
+
         /**
          * Remove everything but the file name from a string.
          *
+         * Inline, so the compiler can resolve it for the __FILE__ literal at the call site.
+         *
          * @param str the input string
          * @return the file name
          */
-        const char *removeSlash(const char *str);
+        inline const char *removeSlash(const char *str) {
+            const char *last = strrchr(str, slash);
+            return last == nullptr ? str : last + 1;
+        }
+
+        /**
+         * Get a small numeric id of the current thread.
+         * The id is cached per thread.
+         *
+         * @return the id of the current thread
+         */
+        uint32_t threadId();
+
+        /**
+         * Capture the return addresses of the current stack.
+         * Does not resolve any symbols, use appendStackTrace for that.
+         *
+         * @param maxFrames the maximum number of frames to capture
+         * @param skip the number of frames to skip above the caller of this function
+         * @return the return addresses, starting with the caller
+         */
+        std::vector<void *> captureStackTrace(unsigned maxFrames, unsigned skip = 0);
+
+        /**
+         * Append a stack trace captured using captureStackTrace to a string,
+         * one frame per line. Resolved symbols are cached per address.
+         *
+         * @param out the string to append to
+         * @param frames the return addresses to resolve
+         */
+        void appendStackTrace(std::string &out, const std::vector<void *> &frames);
+
+        /**
+         * Append a hex dump of binary data to a string. Every line contains
+         * the offset, up to 16 bytes in hex and their printable characters.
+         *
+         * @param out the string to append to
+         * @param data the data to append
+         * @param size the size of the data in bytes
+         * @param offset the offset of the data, printed at the start of every line
+         */
+        void appendHexDump(std::string &out, const void *data, size_t size, size_t offset = 0);
+
+        /**
+         * Append binary data encoded using base64 to a string
+         *
+         * @param out the string to append to
+         * @param data the data to encode
+         * @param size the size of the data in bytes
+         */
+        void appendBase64(std::string &out, const void *data, size_t size);
+
+        /**
+         * A cheap clock for timing trace spans. Uses the time stamp counter
+         * on x86 CPUs with an invariant TSC, calibrated against
+         * std::chrono::steady_clock, and steady_clock everywhere else.
+         */
+        class TraceClock {
+        public:
+            /**
+             * Get the current time in clock ticks
+             *
+             * @return the current time in ticks
+             */
+            static uint64_t now();
+
+            /**
+             * Convert a time in ticks to microseconds since the clock was calibrated
+             *
+             * @param ticks the time in ticks
+             * @return the time in microseconds
+             */
+            static double toMicroseconds(uint64_t ticks);
+
+            /**
+             * Calibrate the clock. Called by the first use of the clock,
+             * only the first call has any effect. Takes about 10 milliseconds
+             * if the time stamp counter is used.
+             */
+            static void calibrate();
+        };
+
+        /**
+         * A trace span, measuring the time until it is destroyed
+         */
+        class TraceSpan {
+        public:
+            /**
+             * Create a trace span. Use the traceSpan macro instead. Usage:
+             *
+             * <code>
+             *    auto span = logger.traceSpan("parse");
+             * </code>
+             *
+             * @param logger the logger to write the span to. Null for a disabled span
+             * @param name the name of the span. Must outlive the logger, e.g. a string literal
+             * @param _file the file name
+             * @param line the line number
+             */
+            TraceSpan(Logger *logger, const char *name, const char *_file, int line);
+
+            /**
+             * Move a trace span
+             *
+             * @param other the span to move
+             */
+            TraceSpan(TraceSpan &&other) noexcept;
+
+            TraceSpan(const TraceSpan &) = delete;
+
+            TraceSpan &operator=(const TraceSpan &) = delete;
+
+            /**
+             * End the span and write it to the logger
+             */
+            ~TraceSpan();
+
+        private:
+            Logger *logger;
+            const char *name;
+            const char *_file;
+            int line;
+            uint64_t start;
+        };
 
         /**
          * A stream for logging
@@ -244,93 +627,1170 @@ namespace markusjx::logging {
         };
     }
 
-    /**
-     * The main logger class
-     */
-    class Logger {
-    public:
+    /**
+     * An additional output for log messages.
+     * Sinks receive every message written by the logger they are
+     * attached to, after the message has been formatted.
+     */
+    class LogSink {
+    public:
+        /**
+         * Write a formatted log message
+         *
+         * @param level the log level of the message
+         * @param _file the file the message originated from
+         * @param line the line the message originated from
+         * @param message the formatted message
+         */
+        virtual void write(LogLevel level, const char *_file, int line, const std::string &message) = 0;
+
+        /**
+         * Called by the logger once a batch of messages has been written.
+         * In ASYNC mode a batch is everything the executor wrote for this
+         * logger at once, in all other modes every message is its own batch.
+         */
+        virtual void flush() {}
+
+        /**
+         * Write all messages and wait until they are on stable storage.
+         * Called instead of flush() for batches which must be durable.
+         * May be called concurrently with write() in SYNC and DEFAULT mode.
+         */
+        virtual void sync() {
+            flush();
+        }
+
+        /**
+         * Destroy the sink
+         */
+        virtual ~LogSink() = default;
+    };
+
+#ifndef LOGGER_WINDOWS
+    /**
+     * The fdatasync policy of a DirectFileSink
+     */
+    enum DataSyncPolicy {
+        // Never call fdatasync, leave writeback to the kernel
+        DATASYNC_NONE = 0,
+        // Call fdatasync after every buffer written on a batch flush
+        DATASYNC_ON_FLUSH = 1,
+        // Call fdatasync at most once per sync interval
+        DATASYNC_INTERVAL = 2,
+        // Call fdatasync after every buffer written
+        DATASYNC_ALWAYS = 3
+    };
+
+    /**
+     * The options of a DirectFileSink
+     */
+    struct DirectFileOptions {
+        // The size of each of the two buffers in bytes. Rounded up to a multiple of 4096
+        size_t bufferSize = 1024 * 1024;
+        // Whether to open the file with O_DIRECT, bypassing the page cache.
+        // Falls back to buffered I/O if the file system does not support it.
+        bool directIO = false;
+        // Whether to append to an existing file instead of truncating it
+        bool append = true;
+        // The fdatasync policy
+        DataSyncPolicy syncPolicy = DATASYNC_NONE;
+        // The interval between two fdatasync calls if the policy is DATASYNC_INTERVAL
+        std::chrono::milliseconds syncInterval = std::chrono::milliseconds(1000);
+        // The number of bytes covered by each entry of the sidecar index written
+        // to "<fileName>.idx". 0 disables the index. See logger-query.
+        size_t indexBlockSize = 0;
+    };
+
+    /**
+     * An entry of a sidecar index, describing a block of a log file.
+     * All times are the times the messages were written to the sink,
+     * which in ASYNC mode may be later than the times they were logged.
+     */
+    struct LogIndexEntry {
+        // The offset of the block in the log file
+        uint64_t offset;
+        // The size of the block in bytes
+        uint64_t size;
+        // The time the first message of the block was written, in milliseconds since the epoch
+        int64_t firstTime;
+        // The time the last message of the block was written, in milliseconds since the epoch
+        int64_t lastTime;
+        // The number of messages in the block
+        uint32_t count;
+        // A bitmap of the log levels of the messages in the block, bit n is set for level n
+        uint32_t levels;
+        // A bloom filter of the call sites of the messages in the block
+        uint64_t callSites[4];
+
+        /**
+         * Check whether the block may contain a message from a call site
+         *
+         * @param _file the file name of the call site
+         * @param line the line of the call site
+         * @return false if the block definitely does not contain a message from the call site
+         */
+        bool mayContain(const char *_file, int line) const;
+
+        /**
+         * Add a call site to the bloom filter
+         *
+         * @param _file the file name of the call site
+         * @param line the line of the call site
+         */
+        void addCallSite(const char *_file, int line);
+    };
+
+    /**
+     * A message of a block of a sidecar index.
+     * The records of a block follow its entry in the index file.
+     */
+    struct LogIndexRecord {
+        // The offset of the message relative to the offset of its block
+        uint32_t offset;
+        // The size of the message in bytes
+        uint32_t size;
+        // The time the message was written to the sink, in milliseconds after the firstTime of its block
+        uint32_t time;
+        // The log level of the message
+        uint32_t level;
+        // A hash of the call site of the message
+        uint32_t callSite;
+
+        /**
+         * Check whether the message was written from a call site
+         *
+         * @param _file the file name of the call site
+         * @param line the line of the call site
+         * @return true if the call site matches, except for hash collisions
+         */
+        bool isFrom(const char *_file, int line) const;
+    };
+
+    /**
+     * Writes the sidecar index of a log file
+     */
+    class LogIndexWriter {
+    public:
+        /**
+         * Create an index writer
+         *
+         * @param fileName the name of the index file
+         * @param append whether to append to an existing index
+         * @param blockSize the number of bytes of the log file covered by each entry
+         */
+        LogIndexWriter(const std::string &fileName, bool append, size_t blockSize);
+
+        /**
+         * Add a message to the index
+         *
+         * @param offset the offset of the message in the log file
+         * @param size the size of the message in bytes
+         * @param level the log level of the message
+         * @param _file the file the message originated from
+         * @param line the line the message originated from
+         */
+        void add(uint64_t offset, size_t size, LogLevel level, const char *_file, int line);
+
+        /**
+         * Read the index of a log file
+         *
+         * @param fileName the name of the index file
+         * @param records if not null, receives the records of all entries in the order of the entries
+         * @return the index entries, empty if the index does not exist
+         */
+        static std::vector<LogIndexEntry> read(const std::string &fileName,
+                                               std::vector<LogIndexRecord> *records = nullptr);
+
+        /**
+         * Write the current entry and close the index file
+         */
+        ~LogIndexWriter();
+
+    private:
+        void write_entry();
+
+        FILE *file;
+        size_t blockSize;
+        LogIndexEntry current;
+        std::vector<LogIndexRecord> records;
+    };
+
+    /**
+     * The options of a LogQuery
+     */
+    struct LogQueryOptions {
+        // Only match messages written at or after this time, in milliseconds since the epoch
+        int64_t from = INT64_MIN;
+        // Only match messages written at or before this time, in milliseconds since the epoch
+        int64_t to = INT64_MAX;
+        // A bitmap of the log levels to match, bit n is set for level n. 0 matches all levels
+        uint32_t levels = 0;
+        // Only match messages from this call site, if not empty
+        std::string siteFile;
+        int siteLine = 0;
+        // Only match messages containing this text, if not empty
+        std::string pattern;
+        // The index file to use. Defaults to "<log file>.idx"
+        std::string indexFile;
+    };
+
+    /**
+     * The statistics of a LogQuery
+     */
+    struct LogQueryStats {
+        // The number of index blocks and the number of blocks read
+        size_t blocks = 0;
+        size_t scannedBlocks = 0;
+        // The size of the log file and the number of bytes read
+        uint64_t fileSize = 0;
+        uint64_t scannedBytes = 0;
+        // The number of bytes which are not indexed and could not be filtered
+        // by time, level or call site, so they were skipped
+        uint64_t skippedBytes = 0;
+    };
+
+    /**
+     * Searches a log file written by a DirectFileSink, using its sidecar index
+     * to only read the blocks which may contain matches. The time, level and
+     * call site of every message are taken from the index, not from its text.
+     */
+    class LogQuery {
+    public:
+        /**
+         * Create a query
+         *
+         * @param logFile the log file to search
+         * @param options the query options
+         */
+        explicit LogQuery(std::string logFile, LogQueryOptions options = LogQueryOptions());
+
+        /**
+         * Write all matching messages
+         *
+         * @param out the file to write the messages to
+         * @return the number of matching messages, -1 if the log file could not be read
+         */
+        long long run(FILE *out);
+
+        /**
+         * Get the statistics of the last run
+         *
+         * @return the statistics
+         */
+        const LogQueryStats &getStats() const;
+
+    private:
+        bool has_index_filters() const;
+
+        long long scan_unindexed(const char *begin, const char *end, FILE *out);
+
+        std::string logFile;
+        LogQueryOptions options;
+        LogQueryStats stats;
+    };
+
+    /**
+     * A file sink which fills one buffer while the previous one is
+     * written to the file by a dedicated I/O thread using pwrite.
+     * The thread writing the log messages never waits for the disk
+     * unless both buffers are full.
+     */
+    class DirectFileSink : public LogSink {
+    public:
+        /**
+         * Create a direct file sink. Usage:
+         *
+         * <code>
+         *    logger.addSink(std::make_shared<DirectFileSink>("out.log"));
+         * </code>
+         *
+         * @param fileName the name of the file to write to
+         * @param options the sink options
+         */
+        explicit DirectFileSink(const std::string &fileName, DirectFileOptions options = DirectFileOptions());
+
+        /**
+         * Copy the message into the current buffer
+         *
+         * @param level the log level of the message
+         * @param _file the file the message originated from
+         * @param line the line the message originated from
+         * @param message the formatted message
+         */
+        void write(LogLevel level, const char *_file, int line, const std::string &message) override;
+
+        /**
+         * Submit the current buffer to the I/O thread.
+         * Does not wait for the data to be written.
+         */
+        void flush() override;
+
+        /**
+         * Write the current buffer and wait until it has
+         * been written and synced using fdatasync
+         */
+        void sync() override;
+
+        /**
+         * Write all remaining data, stop the I/O thread and close the file
+         */
+        ~DirectFileSink() override;
+
+    private:
+        void init(const std::string &fileName);
+
+        void submit(bool flushed);
+
+        void io_thread_main();
+
+        int fd;
+        DirectFileOptions options;
+        size_t alignment;
+        char *buffers[2];
+        int active;
+        size_t activeSize;
+        // The number of bytes at the start of the active buffer which are already on disk
+        size_t activeWritten;
+        // The file offset at which the active buffer will be written
+        size_t activeOffset;
+        const char *pending;
+        size_t pendingSize;
+        size_t pendingOffset;
+        bool pendingFlushed;
+        bool flushRequested;
+        bool run;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread ioThread;
+        std::unique_ptr<LogIndexWriter> index;
+    };
+
+    /**
+     * A sink writing messages into a lock-free ring buffer in a POSIX
+     * shared memory segment, to be collected by a SharedMemoryCollector
+     * running in another process. Writing never waits for the collector,
+     * if the ring is full, the message is dropped.
+     */
+    class SharedMemorySink : public LogSink {
+    public:
+        /**
+         * Create a shared memory sink. The segment is called
+         * "/<name>.<pid>.<n>", where n numbers the sinks created by the
+         * process, the collector must use the same name. Existing segments,
+         * e.g. left behind by a crashed process with the same pid, are never
+         * replaced, the next free number is used instead. Usage:
+         *
+         * <code>
+         *    logger.addSink(std::make_shared<SharedMemorySink>("my-service"));
+         * </code>
+         *
+         * @param name the name shared by all processes writing to the same collector
+         * @param capacity the size of the ring buffer in bytes. Rounded up to a power of two
+         */
+        explicit SharedMemorySink(const std::string &name = "logger", size_t capacity = 4 * 1024 * 1024);
+
+        /**
+         * Copy the message into the ring buffer
+         *
+         * @param level the log level of the message
+         * @param _file the file the message originated from
+         * @param line the line the message originated from
+         * @param message the formatted message
+         */
+        void write(LogLevel level, const char *_file, int line, const std::string &message) override;
+
+        /**
+         * Get the number of messages dropped because the ring buffer was full
+         *
+         * @return the number of dropped messages
+         */
+        LOGGER_MAYBE_UNUSED size_t droppedMessages() const;
+
+        /**
+         * Mark the ring as closed and unmap it. The segment is removed
+         * if it is empty, otherwise by the collector once it has been drained.
+         */
+        ~SharedMemorySink() override;
+
+    private:
+        std::string segmentName;
+        void *segment;
+        size_t segmentSize;
+        std::mutex mtx;
+    };
+
+    /**
+     * Drains the rings of all processes using a SharedMemorySink
+     * with the same name into a single output ordered by time
+     */
+    class SharedMemoryCollector {
+    public:
+        /**
+         * Create a shared memory collector
+         *
+         * @param name the name passed to the SharedMemorySink constructors
+         */
+        explicit SharedMemoryCollector(std::string name = "logger");
+
+        /**
+         * Attach to new rings, write all messages currently available in the
+         * rings to the output and remove the rings of processes which have exited.
+         * The messages collected in a single call are ordered by their timestamp.
+         *
+         * @param out the file to write to
+         * @return the number of messages written
+         */
+        size_t poll(FILE *out);
+
+        /**
+         * Call poll until running is set to false
+         *
+         * @param out the file to write to
+         * @param running whether to continue collecting messages
+         * @param interval the time to wait if no messages were available
+         */
+        void run(FILE *out, const std::atomic<bool> &running,
+                 std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+
+        /**
+         * Unmap all rings
+         */
+        ~SharedMemoryCollector();
+
+    private:
+        struct ring {
+            std::string segmentName;
+            void *segment;
+            size_t segmentSize;
+            // The capacity read from the header when the ring was attached
+            uint64_t capacity;
+            unsigned long long inode;
+            // The number of dropped messages already reported
+            unsigned long long reportedDrops;
+            // Whether the name of the segment has been reused by a new process with the same pid
+            bool orphaned;
+        };
+
+        void attach_new_rings();
+
+        std::string name;
+        std::vector<ring> rings;
+    };
+
+    /**
+     * The type of the socket used by a SocketSink
+     */
+    enum SocketType {
+        // A SOCK_DGRAM socket, every message is sent as its own datagram
+        SOCKET_DATAGRAM = 0,
+        // A SOCK_STREAM socket, messages are delimited by new lines,
+        // or framed using octet counting (RFC 6587) if syslog is enabled
+        SOCKET_STREAM = 1
+    };
+
+    /**
+     * The options of a SocketSink
+     */
+    struct SocketSinkOptions {
+        // The type of the socket
+        SocketType type = SOCKET_DATAGRAM;
+        // Whether to wrap every message into a RFC 5424 syslog header
+        bool syslog = false;
+        // The syslog facility, 1 is "user-level messages"
+        int facility = 1;
+        // The syslog app name
+        std::string appName = "logger";
+        // The number of buffered bytes after which the buffer is sent
+        // without waiting for the end of the batch
+        size_t batchSize = 64 * 1024;
+        // The maximum number of bytes buffered while the agent is slow or
+        // absent. Messages which do not fit into the buffer are dropped.
+        size_t maxBuffered = 4 * 1024 * 1024;
+        // The minimum time between two connection attempts
+        std::chrono::milliseconds reconnectInterval = std::chrono::milliseconds(1000);
+    };
+
+    /**
+     * A sink sending messages to a local agent listening on a Unix domain socket.
+     * Messages are buffered and sent in batches using non-blocking sends,
+     * so a slow or absent agent never blocks the logger. If the agent is
+     * not reachable, the sink reconnects once the reconnect interval has passed.
+     */
+    class SocketSink : public LogSink {
+    public:
+        /**
+         * Create a socket sink. Usage:
+         *
+         * <code>
+         *    SocketSinkOptions options;
+         *    options.syslog = true;
+         *    logger.addSink(std::make_shared<SocketSink>("/dev/log", options));
+         * </code>
+         *
+         * @param path the path of the socket to connect to
+         * @param options the sink options
+         */
+        explicit SocketSink(std::string path, SocketSinkOptions options = SocketSinkOptions());
+
+        /**
+         * Append the message to the buffer and send the
+         * buffer if it is larger than the batch size
+         *
+         * @param level the log level of the message
+         * @param _file the file the message originated from
+         * @param line the line the message originated from
+         * @param message the formatted message
+         */
+        void write(LogLevel level, const char *_file, int line, const std::string &message) override;
+
+        /**
+         * Send as much of the buffer as the socket accepts without blocking
+         */
+        void flush() override;
+
+        /**
+         * Get the number of messages dropped because the buffer was full
+         * or the agent rejected them
+         *
+         * @return the number of dropped messages
+         */
+        LOGGER_MAYBE_UNUSED size_t droppedMessages() const;
+
+        /**
+         * Try to send the rest of the buffer and close the socket
+         */
+        ~SocketSink() override;
+
+    private:
+        bool connect_socket();
+
+        void disconnect();
+
+        void send_buffered();
+
+        void send_datagrams();
+
+        void send_stream();
+
+        void drop_record();
+
+        std::string path;
+        SocketSinkOptions options;
+        std::string hostName;
+        std::string processId;
+        int fd;
+        std::chrono::steady_clock::time_point nextConnect;
+        // The buffered records and the offsets at which they end
+        std::string buffer;
+        std::vector<size_t> records;
+        // The index of the first record which has not been sent completely
+        size_t firstRecord;
+        // The number of bytes at the start of the buffer which have been sent
+        size_t sent;
+        std::atomic<size_t> dropped;
+        std::mutex mtx;
+    };
+#endif //LOGGER_WINDOWS
+
+#ifdef LOGGER_ZLIB
+    /**
+     * The options of a CompressedFileSink
+     */
+    struct CompressedFileOptions {
+        // The zlib compression level, from 1 (fastest) to 9 (smallest)
+        int level = 1;
+        // The number of uncompressed bytes after which the current gzip
+        // member is finished at the end of the next batch
+        size_t frameSize = 1024 * 1024;
+        // The size of the buffer receiving the compressed data
+        size_t bufferSize = 256 * 1024;
+        // Whether to append to an existing file instead of truncating it
+        bool append = true;
+    };
+
+    /**
+     * A sink compressing messages into a gzip file on the writer thread.
+     * The file is a series of gzip members (frames), which can be read
+     * using zcat or gzip -d. At the end of every batch, the compressed data
+     * is flushed to the file, so a crash never loses a written batch.
+     * Only available if the logger was built with zlib.
+     */
+    class CompressedFileSink : public LogSink {
+    public:
+        /**
+         * Create a compressed file sink. Usage:
+         *
+         * <code>
+         *    logger.addSink(std::make_shared<CompressedFileSink>("out.log.gz"));
+         * </code>
+         *
+         * @param fileName the name of the file to write to
+         * @param options the sink options
+         */
+        explicit CompressedFileSink(const std::string &fileName,
+                                    CompressedFileOptions options = CompressedFileOptions());
+
+        /**
+         * Compress the message into the current frame
+         *
+         * @param level the log level of the message
+         * @param _file the file the message originated from
+         * @param line the line the message originated from
+         * @param message the formatted message
+         */
+        void write(LogLevel level, const char *_file, int line, const std::string &message) override;
+
+        /**
+         * Finish the current frame if it is larger than the frame
+         * size, otherwise flush the compressed data written so far
+         */
+        void flush() override;
+
+        /**
+         * Flush the compressed data and wait until it is on stable storage
+         */
+        void sync() override;
+
+        /**
+         * Get the number of uncompressed bytes written to the sink
+         *
+         * @return the number of uncompressed bytes
+         */
+        LOGGER_MAYBE_UNUSED uint64_t bytesIn() const;
+
+        /**
+         * Get the number of compressed bytes written to the file
+         *
+         * @return the number of compressed bytes
+         */
+        LOGGER_MAYBE_UNUSED uint64_t bytesOut() const;
+
+        /**
+         * Finish the current frame and close the file
+         */
+        ~CompressedFileSink() override;
+
+    private:
+        void compress(const char *data, size_t size, int flushMode);
+
+        void end_batch();
+
+        FILE *file;
+        CompressedFileOptions options;
+        // The z_stream, not exposed to avoid including zlib.h
+        void *stream;
+        std::vector<char> out;
+        // The number of uncompressed bytes in the current frame
+        size_t frameInput;
+        // Whether data has been compressed since the last flush
+        bool pending;
+        std::atomic<uint64_t> totalIn;
+        std::atomic<uint64_t> totalOut;
+        std::mutex mtx;
+    };
+#endif //LOGGER_ZLIB
+
+    /**
+     * A named logging category with its own log level.
+     * Categories form a hierarchy using dots in their names, e.g. "net.http"
+     * is a child of "net". Categories without a level inherit the level of
+     * their parent, the root category "" inherits the level of the logger.
+     */
+    class LogCategory {
+    public:
+        /**
+         * Get or create a category. The returned reference is valid until the
+         * program exits. Use the LOGGER_CATEGORY macro to only look up the
+         * category once per call site.
+         *
+         * @param name the name of the category
+         * @return the category
+         */
+        static LogCategory &get(const std::string &name);
+
+        /**
+         * Set the log level of this category and all children which don't have their own level
+         *
+         * @param lvl the new log level
+         */
+        void setLevel(LogLevel lvl);
+
+        /**
+         * Remove the log level of this category, inheriting the level of its parent again
+         */
+        LOGGER_MAYBE_UNUSED void resetLevel();
+
+        /**
+         * Check whether messages of a log level are enabled in this category.
+         * Only performs a single relaxed atomic load.
+         *
+         * @param lvl the log level to check
+         * @param fallback the level to use if neither this category nor its parents have a level
+         * @return true if messages of the level should be written
+         */
+        bool isEnabled(LogLevel lvl, LogLevel fallback) const {
+            const int effective = effectiveLevel.load(std::memory_order_relaxed);
+            return lvl <= (effective < 0 ? static_cast<int>(fallback) : effective);
+        }
+
+        /**
+         * Get the name of this category
+         *
+         * @return the category name
+         */
+        const std::string &getName() const;
+
+    private:
+        LogCategory(std::string name, LogCategory *parent);
+
+        void update_effective_level();
+
+        std::string name;
+        LogCategory *parent;
+        std::vector<LogCategory *> children;
+        // The level used for the enabled check, -1 if the logger level should be used
+        std::atomic<int> effectiveLevel;
+        // The level set on this category, -1 if it inherits the level of its parent
+        int level;
+    };
+
+    class Logger;
+
+    /**
+     * The process-wide budget of memory used by queued messages of all ASYNC loggers.
+     * What a logger does if the budget is exhausted is set using Logger::setBudgetPolicy.
+     */
+    class LogMemoryBudget {
+    public:
+        /**
+         * Set the maximum number of bytes used by queued messages
+         *
+         * @param bytes the limit in bytes. 0 means unlimited
+         */
+        static void setLimit(size_t bytes);
+
+        /**
+         * Get the maximum number of bytes used by queued messages
+         *
+         * @return the limit in bytes. 0 means unlimited
+         */
+        LOGGER_MAYBE_UNUSED static size_t getLimit();
+
+        /**
+         * Get the number of bytes currently used by queued messages
+         *
+         * @return the usage in bytes
+         */
+        static size_t getUsage();
+
+    private:
+        friend class Logger;
+
+        static bool try_reserve(size_t bytes);
+
+        static bool reserve(size_t bytes, std::chrono::milliseconds timeout);
+
+        static void release(size_t bytes);
+
+        static std::atomic<size_t> limit;
+        static std::atomic<size_t> usage;
+        // The number of threads waiting for memory to be released
+        static std::atomic<unsigned> waiting;
+        static std::mutex mtx;
+        static std::condition_variable cv;
+    };
+
+    /**
+     * A pool of threads writing the messages of any number of ASYNC loggers.
+     * Loggers with pending messages are served in a round-robin fashion,
+     * each getting to write a limited batch of messages at a time.
+     */
+    class LoggerExecutor {
+    public:
+        /**
+         * Create a logger executor. Usage:
+         *
+         * <code>
+         *    // Two threads, running on CPUs 2 and 3 with a nice level of 10
+         *    auto executor = std::make_shared<LoggerExecutor>(2, std::vector<int>{2, 3}, 10);
+         *    Logger logger(MODE_FILE, DEBUG, ASYNC, "out.log", "at", executor);
+         * </code>
+         *
+         * @param threads the number of write threads
+         * @param cpuAffinity the CPUs the write threads may run on. Empty for no restriction. Linux only
+         * @param niceLevel the nice level of the write threads. Linux only
+         */
+        explicit LoggerExecutor(unsigned threads = 1, std::vector<int> cpuAffinity = {}, int niceLevel = 0);
+
+        /**
+         * Get the executor used by all ASYNC loggers which are created without an executor.
+         * The default executor uses a single thread and is created on first use.
+         *
+         * @return the default executor
+         */
+        static std::shared_ptr<LoggerExecutor> getDefault();
+
+        /**
+         * Set the executor used by all ASYNC loggers which are
+         * created without an executor after this call
+         *
+         * @param executor the new default executor
+         */
+        LOGGER_MAYBE_UNUSED static void setDefault(std::shared_ptr<LoggerExecutor> executor);
+
+        /**
+         * Write all pending messages and stop the write threads
+         */
+        ~LoggerExecutor();
+
+    private:
+        friend class Logger;
+
+        void add(Logger *logger);
+
+        void remove(Logger *logger);
+
+        void schedule(Logger *logger);
+
+        void thread_main();
+
+        std::vector<int> cpuAffinity;
+        int niceLevel;
+        std::mutex mtx;
+        // Notified if a logger is ready to be served
+        std::condition_variable cv;
+        // Notified if a logger is no longer being served
+        std::condition_variable idle;
+        std::vector<Logger *> loggers;
+        std::deque<Logger *> ready;
+        std::vector<Logger *> busy;
+        bool run;
+        std::vector<std::thread> threads;
+
+        static std::mutex defaultMtx;
+        static std::shared_ptr<LoggerExecutor> defaultExecutor;
+    };
+
+    /**
+     * The main logger class
+     */
+    class Logger {
+    public:
+        /**
+         * A logger constructor
+         */
+        Logger();
+
+        /**
+         * A logger constructor. Usage:
+         *
+         * <code>
+         *    logger::Logger logger(logger::LoggerMode::MODE_FILE, logger::LogLevel::DEBUG, "out.log", "at");
+         * </code>
+         *
+         * @param mode the logger mode
+         * @param syncMode the synchronization mode
+         * @param lvl the logging level
+         * @param fileName the output file name. If empty, only the attached sinks are written to
+         * @param fileMode the logger file mode
+         * @param executor the executor writing the messages in ASYNC mode. Uses the default executor if null
+         */
+        explicit Logger(LoggerMode mode, LogLevel lvl = DEBUG, SyncMode syncMode = DEFAULT,
+                        const char *fileName = "out.log",
+                        const char *fileMode = "at", std::shared_ptr<LoggerExecutor> executor = nullptr);
+
+        /**
+         * Write a debug message.
+         * You should use the debug macro. Usage:
+         *
+         * <code>
+         *    logger.debug("Some message");
+         * </code>
+         *
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param message the message
+         */
+#ifdef LOGGER_INLINE_FAST_PATH
+        template<class T>
+        void _debug(const char *_file, int line, const char *method, T &&message) {
+            if (DEBUG <= level) {
+                write_log_message(log_message("DEBUG", _file, line, method, std::string(std::forward<T>(message)),
+                                              DEBUG));
+            }
+        }
+#else
+        void _debug(const char *_file, int line, const char *method, const std::string &message);
+#endif
+
+        /**
+         * Write an error message.
+         * You should use the error macro. Usage:
+         *
+         * <code>
+         *    logger.error("Some error message");
+         * </code>
+         *
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param message the message
+         */
+#ifdef LOGGER_INLINE_FAST_PATH
+        template<class T>
+        void _error(const char *_file, int line, const char *method, T &&message) {
+            if (ERROR <= level) {
+                write_log_message(log_message("ERROR", _file, line, method, std::string(std::forward<T>(message)),
+                                              ERROR, true));
+            }
+        }
+#else
+        void _error(const char *_file, int line, const char *method, const std::string &message);
+#endif
+
+        /**
+         * Write a error message and append an error
+         *
+         * @param _file the file the error originated from
+         * @param line the line number
+         * @param method the function name
+         * @param message the error message
+         * @param e the exception to append
+         */
+        void _error(const char *_file, int line, const char *method, std::string message, const std::exception &e);
+
+        /**
+         * Write a warning message.
+         * You should use the warning macro. Usage:
+         *
+         * <code>
+         *    logger.warning("Some warning message");
+         * </code>
+         *
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param message the message
+         */
+#ifdef LOGGER_INLINE_FAST_PATH
+        template<class T>
+        void _warning(const char *_file, int line, const char *method, T &&message) {
+            if (WARNING <= level) {
+                write_log_message(log_message("WARN", _file, line, method, std::string(std::forward<T>(message)),
+                                              WARNING, true));
+            }
+        }
+#else
+        void _warning(const char *_file, int line, const char *method, const std::string &message);
+#endif
+
+        /**
+         * Write a formatted debug message.
+         * You should use the debugf macro instead.
+         *
+         * @tparam Args the argument types
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param fmt the format string
+         * @param args the arguments to format
+         */
+        template<class...Args>
+        void _debugf(const char *_file, int line, const char *method, const char *fmt, Args...args) {
+            if (DEBUG <= level) {
+                this->_debug(_file, line, method, LoggerUtils::format(fmt, args...));
+            }
+        }
+
+        /**
+         * Write a formatted warning message.
+         * You should use the warningf macro instead.
+         *
+         * @tparam Args the argument types
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param fmt the format string
+         * @param args the arguments to format
+         */
+        template<class...Args>
+        void _warningf(const char *_file, int line, const char *method, const char *fmt, Args...args) {
+            if (WARNING <= level) {
+                this->_warning(_file, line, method, LoggerUtils::format(fmt, args...));
+            }
+        }
+
         /**
-         * A logger constructor
+         * Write a formatted debug message.
+         * You should use the errorf macro instead.
+         *
+         * @tparam Args the argument types
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param fmt the format string
+         * @param args the arguments to format
          */
-        Logger();
+        template<class...Args>
+        void _errorf(const char *_file, int line, const char *method, const char *fmt, Args...args) {
+            if (ERROR <= level) {
+                this->_error(_file, line, method, LoggerUtils::format(fmt, args...));
+            }
+        }
 
         /**
-         * A logger constructor. Usage:
+         * Write a debug message followed by a binary payload.
+         * Only the raw bytes are copied, they are encoded when the message is written.
+         * You should use the debugPayload macro. Usage:
          *
          * <code>
-         *    logger::Logger logger(logger::LoggerMode::MODE_FILE, logger::LogLevel::DEBUG, "out.log", "at");
+         *    logger.debugPayload("Received frame:", frame.data(), frame.size());
          * </code>
          *
-         * @param mode the logger mode
-         * @param syncMode the synchronization mode
-         * @param lvl the logging level
-         * @param fileName the output file name
-         * @param fileMode the logger file mode
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param message the message
+         * @param data the payload
+         * @param size the size of the payload in bytes
+         * @param encoding how the payload is written
          */
-        explicit Logger(LoggerMode mode, LogLevel lvl = DEBUG, SyncMode syncMode = DEFAULT, const char *fileName = "",
-                        const char *fileMode = "at");
+        void _debugPayload(const char *_file, int line, const char *method, const std::string &message,
+                          const void *data, size_t size, PayloadEncoding encoding = PAYLOAD_HEX) {
+            if (DEBUG <= level) {
+                write_payload("DEBUG", _file, line, method, message, DEBUG, false, data, size, encoding);
+            }
+        }
 
         /**
-         * Write a debug message.
-         * You should use the debug macro. Usage:
+         * Write a warning message followed by a binary payload.
+         * Only the raw bytes are copied, they are encoded when the message is written.
+         * You should use the warningPayload macro. Usage:
          *
          * <code>
-         *    logger.debug("Some message");
+         *    logger.warningPayload("Received frame:", frame.data(), frame.size());
          * </code>
          *
          * @param _file the file name
          * @param line the line number
          * @param method the function name
          * @param message the message
+         * @param data the payload
+         * @param size the size of the payload in bytes
+         * @param encoding how the payload is written
          */
-        void _debug(const char *_file, int line, const char *method, const std::string &message);
+        void _warningPayload(const char *_file, int line, const char *method, const std::string &message,
+                          const void *data, size_t size, PayloadEncoding encoding = PAYLOAD_HEX) {
+            if (WARNING <= level) {
+                write_payload("WARN", _file, line, method, message, WARNING, true, data, size, encoding);
+            }
+        }
 
         /**
-         * Write an error message.
-         * You should use the error macro. Usage:
+         * Write a error message followed by a binary payload.
+         * Only the raw bytes are copied, they are encoded when the message is written.
+         * You should use the errorPayload macro. Usage:
          *
          * <code>
-         *    logger.error("Some error message");
+         *    logger.errorPayload("Received frame:", frame.data(), frame.size());
          * </code>
          *
          * @param _file the file name
          * @param line the line number
          * @param method the function name
          * @param message the message
+         * @param data the payload
+         * @param size the size of the payload in bytes
+         * @param encoding how the payload is written
          */
-        void _error(const char *_file, int line, const char *method, const std::string &message);
+        void _errorPayload(const char *_file, int line, const char *method, const std::string &message,
+                          const void *data, size_t size, PayloadEncoding encoding = PAYLOAD_HEX) {
+            if (ERROR <= level) {
+                write_payload("ERROR", _file, line, method, message, ERROR, true, data, size, encoding);
+            }
+        }
 
         /**
-         * Write a error message and append an error
+         * Write a debug message to a category.
+         * You should use the debugc macro. Usage:
          *
-         * @param _file the file the error originated from
+         * <code>
+         *    logger.debugc("net.http", "Some message");
+         * </code>
+         *
+         * @tparam T the message type
+         * @param category the category
+         * @param _file the file name
          * @param line the line number
          * @param method the function name
-         * @param message the error message
-         * @param e the exception to append
+         * @param message the message. Only converted to a string if the message is enabled
          */
-        void _error(const char *_file, int line, const char *method, std::string message, const std::exception &e);
+        template<class T>
+        void _debug(const LogCategory &category, const char *_file, int line, const char *method, T &&message) {
+            if (category.isEnabled(DEBUG, level)) {
+                write_log_message(log_message("DEBUG", _file, line, method, std::string(std::forward<T>(message)),
+                                              DEBUG, false, category.getName().c_str()));
+            }
+        }
 
         /**
-         * Write a warning message.
-         * You should use the warning macro. Usage:
+         * Write a warning message to a category.
+         * You should use the warningc macro.
          *
-         * <code>
-         *    logger.warning("Some warning message");
-         * </code>
+         * @tparam T the message type
+         * @param category the category
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param message the message. Only converted to a string if the message is enabled
+         */
+        template<class T>
+        void _warning(const LogCategory &category, const char *_file, int line, const char *method, T &&message) {
+            if (category.isEnabled(WARNING, level)) {
+                write_log_message(log_message("WARN", _file, line, method, std::string(std::forward<T>(message)),
+                                              WARNING, true, category.getName().c_str()));
+            }
+        }
+
+        /**
+         * Write an error message to a category.
+         * You should use the errorc macro.
          *
+         * @tparam T the message type
+         * @param category the category
          * @param _file the file name
          * @param line the line number
          * @param method the function name
-         * @param message the message
+         * @param message the message. Only converted to a string if the message is enabled
          */
-        void _warning(const char *_file, int line, const char *method, const std::string &message);
+        template<class T>
+        void _error(const LogCategory &category, const char *_file, int line, const char *method, T &&message) {
+            if (category.isEnabled(ERROR, level)) {
+                write_log_message(log_message("ERROR", _file, line, method, std::string(std::forward<T>(message)),
+                                              ERROR, true, category.getName().c_str()));
+            }
+        }
 
         /**
-         * Write a formatted debug message.
-         * You should use the debugf macro instead.
+         * Write an error message to a category and append an error
+         *
+         * @param category the category
+         * @param _file the file the error originated from
+         * @param line the line number
+         * @param method the function name
+         * @param message the error message
+         * @param e the exception to append
+         */
+        void _error(const LogCategory &category, const char *_file, int line, const char *method,
+                    const std::string &message, const std::exception &e);
+
+        /**
+         * Write a formatted debug message to a category.
+         * You should use the debugcf macro instead.
          *
          * @tparam Args the argument types
+         * @param category the category
          * @param _file the file name
          * @param line the line number
          * @param method the function name
@@ -338,20 +1798,19 @@ namespace markusjx::logging {
          * @param args the arguments to format
          */
         template<class...Args>
-        void _debugf(const char *_file, int line, const char *method, const char *fmt, Args...args) {
-            int size = snprintf(nullptr, 0, fmt, args...);
-            std::string out(size + 1, '\0');
-
-            snprintf(out.data(), out.size(), fmt, args...);
-            out.resize(strlen(out.c_str()));
-            this->_debug(_file, line, method, out);
+        void _debugf(const LogCategory &category, const char *_file, int line, const char *method, const char *fmt,
+                     Args...args) {
+            if (category.isEnabled(DEBUG, level)) {
+                this->_debug(category, _file, line, method, LoggerUtils::format(fmt, args...));
+            }
         }
 
         /**
-         * Write a formatted warning message.
-         * You should use the warningf macro instead.
+         * Write a formatted warning message to a category.
+         * You should use the warningcf macro instead.
          *
          * @tparam Args the argument types
+         * @param category the category
          * @param _file the file name
          * @param line the line number
          * @param method the function name
@@ -359,20 +1818,19 @@ namespace markusjx::logging {
          * @param args the arguments to format
          */
         template<class...Args>
-        void _warningf(const char *_file, int line, const char *method, const char *fmt, Args...args) {
-            int size = snprintf(nullptr, 0, fmt, args...);
-            std::string out(size + 1, '\0');
-
-            snprintf(out.data(), out.size(), fmt, args...);
-            out.resize(strlen(out.c_str()));
-            this->_warning(_file, line, method, out);
+        void _warningf(const LogCategory &category, const char *_file, int line, const char *method, const char *fmt,
+                       Args...args) {
+            if (category.isEnabled(WARNING, level)) {
+                this->_warning(category, _file, line, method, LoggerUtils::format(fmt, args...));
+            }
         }
 
         /**
-         * Write a formatted debug message.
-         * You should use the errorf macro instead.
+         * Write a formatted error message to a category.
+         * You should use the errorcf macro instead.
          *
          * @tparam Args the argument types
+         * @param category the category
          * @param _file the file name
          * @param line the line number
          * @param method the function name
@@ -380,13 +1838,11 @@ namespace markusjx::logging {
          * @param args the arguments to format
          */
         template<class...Args>
-        void _errorf(const char *_file, int line, const char *method, const char *fmt, Args...args) {
-            int size = snprintf(nullptr, 0, fmt, args...);
-            std::string out(size + 1, '\0');
-
-            snprintf(out.data(), out.size(), fmt, args...);
-            out.resize(strlen(out.c_str()));
-            this->_error(_file, line, method, out);
+        void _errorf(const LogCategory &category, const char *_file, int line, const char *method, const char *fmt,
+                     Args...args) {
+            if (category.isEnabled(ERROR, level)) {
+                this->_error(category, _file, line, method, LoggerUtils::format(fmt, args...));
+            }
         }
 
         /**
@@ -435,15 +1891,146 @@ namespace markusjx::logging {
         LoggerUtils::LoggerStream _errorStream(const char *_file, int line, const char *method);
 
         /**
-         * The logger destructor
+         * Add an additional output to this logger.
+         * The sink will receive all messages written after this call
+         * unless the logger mode is MODE_NONE. May be called while
+         * other threads are writing messages to this logger.
+         *
+         * @param sink the sink to add
+         */
+        void addSink(std::shared_ptr<LogSink> sink);
+
+        /**
+         * Set the maximum number of queued messages of a log level in ASYNC mode.
+         * Every log level has its own queue and the queues are drained in order
+         * of priority, so errors are written before any queued warnings or debug
+         * messages. Messages written while their queue is full are dropped and
+         * a summary of the dropped messages is written once the queues are empty.
+         *
+         * @param lvl the log level to set the capacity for
+         * @param capacity the maximum number of queued messages. 0 means unlimited
+         */
+        void setQueueCapacity(LogLevel lvl, size_t capacity);
+
+        /**
+         * Set the durability of the messages of a log level.
+         * In ASYNC mode the logger thread commits every batch containing a message
+         * with the strongest durability of all messages in the batch, without
+         * blocking the caller. In all other modes the caller waits until its
+         * message has been committed. Callers waiting for a sync at the same time
+         * share a single fdatasync call.
+         *
+         * @param lvl the log level to set the durability for
+         * @param durability the durability of the messages
+         */
+        void setDurability(LogLevel lvl, Durability durability);
+
+        /**
+         * Wait until all messages written before this call have been
+         * written to the log file and the sinks and flush them.
+         *
+         * @param sync whether to also wait until the messages are on stable storage
+         */
+        void flush(bool sync = false);
+
+        /**
+         * Enable or disable the coalescing of repeated messages.
+         * If enabled, consecutive identical messages from the same call site
+         * are only written once, followed by a "Last message repeated N times"
+         * summary once a different message is written, the message is repeated after
+         * the time window has passed, coalescing is disabled or the logger is destroyed.
+         * In ASYNC mode, the write thread also writes the summary once the time window
+         * has passed without any further message.
+         *
+         * @param enabled whether to coalesce repeated messages
+         * @param window the maximum time between two summaries of the same message
+         */
+        void setCoalesceRepeated(bool enabled, std::chrono::milliseconds window = std::chrono::seconds(1));
+
+        /**
+         * Capture a stack trace whenever an exception is logged using
+         * the error macro. Only the return addresses are captured at the error
+         * site, they are resolved when the message is written, which is done
+         * by the logger thread in ASYNC mode. Functions of the executable are
+         * only resolved if it has been linked using -rdynamic.
+         *
+         * @param maxFrames the maximum number of frames to capture. 0 disables stack traces
+         */
+        void setStackTraces(unsigned maxFrames);
+
+        /**
+         * Set what this logger does with a message in ASYNC mode
+         * if the memory budget of all loggers is exhausted.
+         *
+         * @param policy the policy
+         * @param timeout the maximum time to wait for memory using BUDGET_BLOCK
+         */
+        void setBudgetPolicy(BudgetPolicy policy, std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
+
+        /**
+         * Get the number of bytes used by the queued messages of this logger
+         *
+         * @return the number of bytes counted against the memory budget
+         */
+        LOGGER_MAYBE_UNUSED size_t getQueuedBytes();
+
+        /**
+         * Write trace spans created by this logger to a file.
+         * Spans are only recorded after this has been called,
+         * which must happen before any span is started.
+         *
+         * @param fileName the name of the trace file. Existing files are overwritten
+         * @param format the output format
+         */
+        void setTraceOutput(const char *fileName, TraceFormat format = TRACE_JSON);
+
+        /**
+         * Start a trace span.
+         * You should use the traceSpan macro. Usage:
+         *
+         * <code>
+         *    {
+         *        auto span = logger.traceSpan("parse");
+         *        // ...
+         *    } // The span ends here
+         * </code>
+         *
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param name the span name. Must outlive the logger, e.g. a string literal
+         * @return the span, writing itself to the logger when destroyed
+         */
+        LoggerUtils::TraceSpan _traceSpan(const char *_file, int line, const char *method, const char *name);
+
+        /**
+         * The logger destructor. In ASYNC mode, waits up to five seconds for the
+         * executor to write all queued messages and writes the rest itself
          */
         ~Logger();
 
     private:
+        friend class LoggerExecutor;
+        friend class LoggerUtils::TraceSpan;
+        friend class StaticLogger;
+
+        struct trace_span {
+            const char *name;
+            const char *_file;
+            int line;
+            uint32_t threadId;
+            uint64_t start;
+            uint64_t end;
+        };
+
+        void write_span(const trace_span &span);
+
+        void write_span_impl(const trace_span &span);
+
         class log_message {
         public:
             log_message(const char *level, const char *_file, int line, const char *method, std::string message,
-                        LogLevel logLevel, bool to_stderr = false);
+                        LogLevel logLevel, bool to_stderr = false, const char *category = nullptr);
 
             LogLevel logLevel;
             const char *method;
@@ -452,20 +2039,158 @@ namespace markusjx::logging {
             int line;
             std::string message;
             bool to_stderr;
+            // The name of the category, null if the message has no category
+            const char *category;
+            // The unresolved stack trace of the message, if any
+            std::vector<void *> stackTrace;
+            // The thread which wrote the message and its context, captured once the message passed
+            // the level checks. A thread id of 0 is formatted as the thread writing the message
+            uint32_t threadId;
+            std::shared_ptr<const LogContext::snapshot> context;
+            // The raw bytes of a binary payload, if any
+            std::string payload;
+            PayloadEncoding payloadEncoding;
+            // The number of bytes reserved from the memory budget while the message is queued
+            size_t queuedSize;
         };
 
-        void write_log_message(const log_message &message);
+        bool is_enabled(const log_message &message) const;
+
+        void write_log_message(log_message message);
+
+        void dispatch_log_message(log_message message);
+
+        void write_coalesced(log_message message);
+
+        void write_payload(const char *lvl, const char *_file, int line, const char *method,
+                           const std::string &message, LogLevel logLevel, bool to_stderr, const void *data,
+                           size_t size, PayloadEncoding encoding);
+
+        static void append_payload(std::string &out, const log_message &message, size_t offset, size_t size);
+
+        void write_error(const char *_file, int line, const char *method, std::string message,
+                         const std::exception &e, const char *category, std::vector<void *> stackTrace);
+
+        std::vector<log_message> take_repeated_summary();
+
+        void dispatch_log_messages(std::vector<log_message> messages);
+
+        void flush_repeated();
+
+        bool drain(size_t maxMessages);
 
         void write_log_impl(const log_message &message);
 
+        log_message *next_queued_message();
+
+        void write_dropped_summary(std::unique_lock<std::mutex> &lock);
+
+        void flush_sinks();
+
+        static size_t queued_size(const log_message &message);
+
+        bool reserve_queue_memory(std::unique_lock<std::mutex> &lock, const log_message &message, size_t size);
+
+        void spill_message(const log_message &message);
+
+        bool write_spilled(std::unique_lock<std::mutex> &lock);
+
+        bool queues_empty();
+
+        std::string format_message(const log_message &message);
+
+        void write_formatted(LogLevel logLevel, const char *_file, int line, bool to_stderr,
+                             const std::string &formatted);
+
+        void commit(Durability durability);
+
+        void sync_written(uint64_t sequence);
+
         FILE *file;
         LoggerMode _mode;
         SyncMode sync;
         LogLevel level;
         std::mutex mtx;
-        std::thread writeThread;
-        std::deque<log_message> messageQueue;
-        bool run;
+        std::shared_ptr<LoggerExecutor> executor;
+        // Whether this logger is queued in or being served by the executor
+        std::atomic<bool> scheduled;
+        // One queue per log level, indexed by level - 1
+        std::deque<log_message> messageQueues[3];
+        size_t queueCapacity[3];
+        size_t droppedMessages[3];
+        // The number of messages and trace spans dropped because the memory budget was exhausted
+        size_t budgetDropped[3];
+        size_t droppedSpans;
+        std::condition_variable queueCondition;
+        std::atomic<bool> coalesce;
+        std::atomic<unsigned> stackTraceFrames;
+        std::chrono::milliseconds coalesceWindow;
+        std::mutex repeatMtx;
+
+        // The call site of the last message written while coalescing repeated messages
+        struct repeat_state {
+            size_t hash = 0;
+            size_t size = 0;
+            const char *_file = nullptr;
+            int line = 0;
+            const char *method = nullptr;
+            const char *level = nullptr;
+            LogLevel logLevel = NONE;
+            bool to_stderr = false;
+            const char *category = nullptr;
+            // The thread which wrote the message and its context, used for the summary
+            uint32_t threadId = 0;
+            std::shared_ptr<const LogContext::snapshot> context;
+            // The number of suppressed messages, -1 if there is no previous message
+            long long count = -1;
+            std::chrono::steady_clock::time_point start;
+        } repeatState;
+        // Replaced as a whole when a sink is added, so the sinks can be used without holding a lock
+        std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>> sinks;
+
+        // The durability of every log level and the state of committed messages
+        struct commit_state {
+            // Atomic, as it is read without holding the lock in DEFAULT mode
+            std::atomic<Durability> durability[3] = {DURABILITY_NONE, DURABILITY_NONE, DURABILITY_NONE};
+            // The number of messages per lane queued, written and committed in ASYNC mode
+            uint64_t enqueued[3] = {0, 0, 0};
+            uint64_t written[3] = {0, 0, 0};
+            uint64_t committed[3] = {0, 0, 0};
+            // The number of the last commit started and the last commit finished
+            uint64_t started = 0;
+            uint64_t finished = 0;
+            // The number of threads waiting in flush()
+            unsigned flushRequests = 0;
+            unsigned syncRequests = 0;
+            // The number of the commit the waiting threads need at least
+            uint64_t requested = 0;
+        } commitState;
+        // Group commit state in SYNC and DEFAULT mode, the sequence numbers count written messages
+        std::mutex syncMtx;
+        std::condition_variable syncCondition;
+        std::atomic<uint64_t> writtenSequence;
+        uint64_t syncedSequence;
+        bool syncing;
+        BudgetPolicy budgetPolicy;
+        std::chrono::milliseconds budgetTimeout;
+        // The number of bytes of all queued messages and trace spans counted against the memory budget
+        size_t queuedBytes;
+
+        // Messages written to a temporary file while the memory budget is exhausted
+        struct spill_state {
+            FILE *file = nullptr;
+            long readOffset = 0;
+            long writeOffset = 0;
+            // The number of messages in the file which have not been written yet
+            size_t pending = 0;
+        } spillState;
+        std::deque<trace_span> spanQueue;
+        std::mutex traceMtx;
+        FILE *traceFile;
+        // Whether a trace output has been set, read without holding traceMtx when a span starts
+        std::atomic<bool> tracing;
+        TraceFormat traceFormat;
+        bool firstTraceEvent;
 
         void init(const char *fileName, const char *fileMode);
     };
@@ -489,11 +2214,11 @@ namespace markusjx::logging {
          *
          * @param mode the logger mode
          * @param lvl the logging level
-         * @param fileName the output file name
+         * @param fileName the output file name. If empty, only the attached sinks are written to
          * @param fileMode the logger file mode
          */
         LOGGER_MAYBE_UNUSED static void
-        create(LoggerMode mode, LogLevel lvl = DEBUG, SyncMode syncMode = DEFAULT, const char *fileName = "",
+        create(LoggerMode mode, LogLevel lvl = DEBUG, SyncMode syncMode = DEFAULT, const char *fileName = "out.log",
                const char *fileMode = "at");
 
         /**
@@ -509,8 +2234,15 @@ namespace markusjx::logging {
          * @param method the function name
          * @param message the message
          */
+#ifdef LOGGER_INLINE_FAST_PATH
+        template<class T>
+        static void _debug(const char *_file, int line, const char *method, T &&message) {
+            instance->_debug(_file, line, method, std::forward<T>(message));
+        }
+#else
         LOGGER_MAYBE_UNUSED static void
         _debug(const char *_file, int line, const char *method, const std::string &message);
+#endif
 
         /**
          * Write a error message.
@@ -525,8 +2257,15 @@ namespace markusjx::logging {
          * @param method the function name
          * @param message the message
          */
+#ifdef LOGGER_INLINE_FAST_PATH
+        template<class T>
+        static void _error(const char *_file, int line, const char *method, T &&message) {
+            instance->_error(_file, line, method, std::forward<T>(message));
+        }
+#else
         LOGGER_MAYBE_UNUSED static void
         _error(const char *_file, int line, const char *method, const std::string &message);
+#endif
 
         /**
          * Write a error message and append an error
@@ -553,8 +2292,15 @@ namespace markusjx::logging {
          * @param method the function name
          * @param message the message
          */
+#ifdef LOGGER_INLINE_FAST_PATH
+        template<class T>
+        static void _warning(const char *_file, int line, const char *method, T &&message) {
+            instance->_warning(_file, line, method, std::forward<T>(message));
+        }
+#else
         LOGGER_MAYBE_UNUSED static void
         _warning(const char *_file, int line, const char *method, const std::string &message);
+#endif
 
         /**
          * Write a formatted debug message.
@@ -604,6 +2350,108 @@ namespace markusjx::logging {
             instance->_errorf(_file, line, method, fmt, args...);
         }
 
+        /**
+         * Write a message followed by a binary payload.
+         * You should use the debugPayload, warningPayload and errorPayload macros instead.
+         *
+         * @tparam Args the argument types
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param args the message, the payload, its size and optionally the encoding
+         */
+        template<class...Args>
+        static void _debugPayload(const char *_file, int line, const char *method, Args &&...args) {
+            instance->_debugPayload(_file, line, method, std::forward<Args>(args)...);
+        }
+
+        template<class...Args>
+        static void _warningPayload(const char *_file, int line, const char *method, Args &&...args) {
+            instance->_warningPayload(_file, line, method, std::forward<Args>(args)...);
+        }
+
+        template<class...Args>
+        static void _errorPayload(const char *_file, int line, const char *method, Args &&...args) {
+            instance->_errorPayload(_file, line, method, std::forward<Args>(args)...);
+        }
+
+        /**
+         * Write a message to a category.
+         * You should use the debugc, warningc and errorc macros instead. Usage:
+         *
+         * <code>
+         *    logger::StaticLogger::debugc("net.http", "Some message");
+         * </code>
+         *
+         * @tparam Args the argument types
+         * @param category the category
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param args the message
+         */
+        template<class...Args>
+        static void _debug(const LogCategory &category, const char *_file, int line, const char *method,
+                           Args &&...args) {
+            instance->_debug(category, _file, line, method, std::forward<Args>(args)...);
+        }
+
+        template<class...Args>
+        static void _warning(const LogCategory &category, const char *_file, int line, const char *method,
+                             Args &&...args) {
+            instance->_warning(category, _file, line, method, std::forward<Args>(args)...);
+        }
+
+        template<class T>
+        static void _error(const LogCategory &category, const char *_file, int line, const char *method,
+                           T &&message) {
+            instance->_error(category, _file, line, method, std::forward<T>(message));
+        }
+
+        /**
+         * Write an error message to a category and append an error.
+         * You should use the errorc macro instead.
+         *
+         * @param category the category
+         * @param _file the file the error originated from
+         * @param line the line number
+         * @param method the function name
+         * @param message the error message
+         * @param e the exception to append
+         */
+        static void _error(const LogCategory &category, const char *_file, int line, const char *method,
+                           const std::string &message, const std::exception &e);
+
+        /**
+         * Write a formatted message to a category.
+         * You should use the debugcf, warningcf and errorcf macros instead.
+         *
+         * @tparam Args the argument types
+         * @param category the category
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param fmt the format string
+         * @param args the arguments to format
+         */
+        template<class...Args>
+        static void _debugf(const LogCategory &category, const char *_file, int line, const char *method,
+                            const char *fmt, Args...args) {
+            instance->_debugf(category, _file, line, method, fmt, args...);
+        }
+
+        template<class...Args>
+        static void _warningf(const LogCategory &category, const char *_file, int line, const char *method,
+                              const char *fmt, Args...args) {
+            instance->_warningf(category, _file, line, method, fmt, args...);
+        }
+
+        template<class...Args>
+        static void _errorf(const LogCategory &category, const char *_file, int line, const char *method,
+                            const char *fmt, Args...args) {
+            instance->_errorf(category, _file, line, method, fmt, args...);
+        }
+
         /**
          * Get the debug stream.
          * You should use the debugStream macro. Usage:
@@ -652,6 +2500,31 @@ namespace markusjx::logging {
         LOGGER_MAYBE_UNUSED static LoggerUtils::LoggerStream
         _errorStream(const char *_file, int line, const char *method);
 
+        /**
+         * Start a trace span.
+         * You should use the traceSpan macro. Usage:
+         *
+         * <code>
+         *    auto span = logger::StaticLogger::traceSpan("parse");
+         * </code>
+         *
+         * @param _file the file name
+         * @param line the line number
+         * @param method the function name
+         * @param name the span name. Must outlive the logger, e.g. a string literal
+         * @return the span
+         */
+        LOGGER_MAYBE_UNUSED static LoggerUtils::TraceSpan
+        _traceSpan(const char *_file, int line, const char *method, const char *name);
+
+        /**
+         * Capture stack traces of errors logged with an exception.
+         * See Logger::setStackTraces.
+         *
+         * @param maxFrames the maximum number of frames to capture, 0 to disable stack traces
+         */
+        LOGGER_MAYBE_UNUSED static void setStackTraces(unsigned maxFrames);
+
         /**
          * Destroy the logger instance
          */
@@ -23,4 +23,20 @@
 #undef warningStream
 #undef errorStream
 
+// Un-define all category macros
+#undef debugc
+#undef warningc
+#undef errorc
+#undef debugcf
+#undef warningcf
+#undef errorcf
+
+// Un-define the trace span macro
+#undef traceSpan
+
+// Un-define all payload macros
+#undef debugPayload
+#undef warningPayload
+#undef errorPayload
+
 #endif //LOGGER_LOGGER_UNDEF_HPP
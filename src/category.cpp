@@ -0,0 +1,87 @@
+#include <map>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    // Categories are never destroyed, so references to them stay valid
+    // even while other static objects are being destroyed
+    std::mutex &categories_mutex() {
+        static auto *mtx = new std::mutex();
+        return *mtx;
+    }
+
+    std::map<std::string, LogCategory *> &categories() {
+        static auto *map = new std::map<std::string, LogCategory *>();
+        return *map;
+    }
+}
+
+LogCategory::LogCategory(std::string name, LogCategory *parent) : name(std::move(name)), parent(parent), children(),
+                                                                  effectiveLevel(-1), level(-1) {
+    if (parent != nullptr) {
+        effectiveLevel = parent->effectiveLevel.load();
+        parent->children.push_back(this);
+    }
+}
+
+LogCategory &LogCategory::get(const std::string &name) {
+    std::unique_lock<std::mutex> lock(categories_mutex());
+    auto &map = categories();
+
+    auto it = map.find(name);
+    if (it != map.end()) {
+        return *it->second;
+    }
+
+    // Create all missing parents, starting with the root category
+    LogCategory *parent = nullptr;
+    size_t end = 0;
+    while (true) {
+        const std::string parentName = name.substr(0, end);
+        auto parentIt = map.find(parentName);
+        if (parentIt == map.end()) {
+            parentIt = map.emplace(parentName, new LogCategory(parentName, parent)).first;
+        }
+
+        parent = parentIt->second;
+        if (end == name.size()) break;
+
+        end = name.find('.', end + 1);
+        if (end == std::string::npos) end = name.size();
+    }
+
+    return *parent;
+}
+
+void LogCategory::setLevel(LogLevel lvl) {
+    std::unique_lock<std::mutex> lock(categories_mutex());
+    level = lvl;
+    update_effective_level();
+}
+
+LOGGER_MAYBE_UNUSED void LogCategory::resetLevel() {
+    std::unique_lock<std::mutex> lock(categories_mutex());
+    level = -1;
+    update_effective_level();
+}
+
+const std::string &LogCategory::getName() const {
+    return name;
+}
+
+void LogCategory::update_effective_level() {
+    if (level >= 0) {
+        effectiveLevel.store(level, std::memory_order_relaxed);
+    } else {
+        effectiveLevel.store(parent == nullptr ? -1 : parent->effectiveLevel.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+    }
+
+    for (LogCategory *child : children) {
+        child->update_effective_level();
+    }
+}
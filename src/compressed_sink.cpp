@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <zlib.h>
+
+#ifdef _WIN32
+#   include <io.h>
+#else
+#   include <unistd.h>
+#endif
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    // Write a gzip header and trailer instead of a zlib header
+    constexpr int gzip_window_bits = 15 + 16;
+
+    z_stream *get_stream(void *stream) {
+        return static_cast<z_stream *>(stream);
+    }
+}
+
+CompressedFileSink::CompressedFileSink(const std::string &fileName, CompressedFileOptions options)
+        : file(nullptr), options(options), stream(nullptr), out(std::max<size_t>(options.bufferSize, 4096)),
+          frameInput(0), pending(false), totalIn(0), totalOut(0), mtx() {
+#ifdef LOGGER_WINDOWS
+    if (fopen_s(&file, fileName.c_str(), options.append ? "ab" : "wb") != 0) {
+        file = nullptr;
+    }
+#else
+    file = fopen(fileName.c_str(), options.append ? "ab" : "wb");
+#endif
+    if (file == nullptr) {
+        perror("Could not open the compressed log file");
+        return;
+    }
+
+    auto *s = new z_stream();
+    if (deflateInit2(s, options.level, Z_DEFLATED, gzip_window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "Could not initialize the compressor\n");
+        delete s;
+        fclose(file);
+        file = nullptr;
+        return;
+    }
+
+    stream = s;
+}
+
+void CompressedFileSink::write(LogLevel, const char *, int, const std::string &message) {
+    if (stream == nullptr || message.empty()) return;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    compress(message.data(), message.size(), Z_NO_FLUSH);
+    frameInput += message.size();
+    pending = true;
+    totalIn.fetch_add(message.size(), std::memory_order_relaxed);
+}
+
+void CompressedFileSink::flush() {
+    if (stream == nullptr) return;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    end_batch();
+}
+
+void CompressedFileSink::sync() {
+    if (stream == nullptr) return;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    end_batch();
+#ifdef LOGGER_WINDOWS
+    _commit(_fileno(file));
+#else
+    fdatasync(fileno(file));
+#endif
+}
+
+uint64_t CompressedFileSink::bytesIn() const {
+    return totalIn.load(std::memory_order_relaxed);
+}
+
+uint64_t CompressedFileSink::bytesOut() const {
+    return totalOut.load(std::memory_order_relaxed);
+}
+
+CompressedFileSink::~CompressedFileSink() {
+    if (stream != nullptr) {
+        // An empty frame would still write a gzip header and trailer
+        if (frameInput > 0) {
+            compress(nullptr, 0, Z_FINISH);
+        }
+
+        deflateEnd(get_stream(stream));
+        delete get_stream(stream);
+    }
+
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+void CompressedFileSink::compress(const char *data, size_t size, int flushMode) {
+    z_stream *s = get_stream(stream);
+    s->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    s->avail_in = static_cast<uInt>(size);
+
+    // Run deflate until it stops filling the whole output buffer,
+    // at which point all input has been consumed and flushed as requested
+    do {
+        s->next_out = reinterpret_cast<Bytef *>(out.data());
+        s->avail_out = static_cast<uInt>(out.size());
+        deflate(s, flushMode);
+
+        const size_t have = out.size() - s->avail_out;
+        if (have > 0) {
+            fwrite(out.data(), 1, have, file);
+            totalOut.fetch_add(have, std::memory_order_relaxed);
+        }
+    } while (s->avail_out == 0);
+}
+
+void CompressedFileSink::end_batch() {
+    if (pending) {
+        if (frameInput >= options.frameSize) {
+            // Finish the gzip member, the next write starts a new one
+            compress(nullptr, 0, Z_FINISH);
+            deflateReset(get_stream(stream));
+            frameInput = 0;
+        } else {
+            // Flush to a byte boundary while keeping the dictionary, so small
+            // batches stay in the same frame but can still be decompressed
+            compress(nullptr, 0, Z_SYNC_FLUSH);
+        }
+
+        pending = false;
+    }
+
+    fflush(file);
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <utility>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    /**
+     * The context of a thread. Only accessed by its own thread
+     */
+    struct thread_context {
+        std::vector<std::pair<std::string, std::string>> values;
+        std::string threadName;
+        // The rendered context, replaced whenever the context changes
+        std::shared_ptr<const LogContext::snapshot> rendered;
+
+        void render() {
+            auto snapshot = std::make_shared<LogContext::snapshot>();
+            snapshot->threadName = threadName;
+            for (const auto &value : values) {
+                if (!snapshot->values.empty()) {
+                    snapshot->values.push_back(' ');
+                }
+
+                snapshot->values.append(value.first).append("=").append(value.second);
+            }
+
+            rendered = std::move(snapshot);
+        }
+
+        std::vector<std::pair<std::string, std::string>>::iterator find(const std::string &key) {
+            return std::find_if(values.begin(), values.end(), [&key](const auto &value) {
+                return value.first == key;
+            });
+        }
+    };
+
+    thread_local thread_context context;
+}
+
+void LogContext::put(const std::string &key, const std::string &value) {
+    auto it = context.find(key);
+    if (it != context.values.end()) {
+        it->second = value;
+    } else {
+        context.values.emplace_back(key, value);
+    }
+
+    context.render();
+}
+
+void LogContext::remove(const std::string &key) {
+    auto it = context.find(key);
+    if (it != context.values.end()) {
+        context.values.erase(it);
+        context.render();
+    }
+}
+
+LOGGER_MAYBE_UNUSED void LogContext::clear() {
+    context.values.clear();
+    context.render();
+}
+
+void LogContext::setThreadName(const std::string &name) {
+    context.threadName = name;
+    context.render();
+}
+
+std::shared_ptr<const LogContext::snapshot> LogContext::current() {
+    return context.rendered;
+}
+
+// Scope class ==========================================
+
+LogContext::Scope::Scope(std::string key, const std::string &value) : key(std::move(key)), previous(),
+                                                                      hadPrevious(false) {
+    auto it = context.find(this->key);
+    if (it != context.values.end()) {
+        previous = it->second;
+        hadPrevious = true;
+    }
+
+    put(this->key, value);
+}
+
+LogContext::Scope::~Scope() {
+    if (hadPrevious) {
+        put(key, previous);
+    } else {
+        remove(key);
+    }
+}
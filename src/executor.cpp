@@ -0,0 +1,150 @@
+#include <iostream>
+#include <algorithm>
+
+#ifdef __linux__
+#   include <pthread.h>
+#   include <sched.h>
+#   include <unistd.h>
+#   include <sys/resource.h>
+#   include <sys/syscall.h>
+#endif
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    // The maximum number of messages written for a logger before serving the next one
+    constexpr size_t batch_size = 256;
+}
+
+LoggerExecutor::LoggerExecutor(unsigned threads, std::vector<int> cpuAffinity, int niceLevel)
+        : cpuAffinity(std::move(cpuAffinity)), niceLevel(niceLevel), mtx(), cv(), idle(), loggers(), ready(), busy(),
+          run(true), threads() {
+    for (unsigned i = 0; i < std::max(threads, 1u); i++) {
+        this->threads.emplace_back(&LoggerExecutor::thread_main, this);
+    }
+}
+
+std::shared_ptr<LoggerExecutor> LoggerExecutor::getDefault() {
+    std::unique_lock<std::mutex> lock(defaultMtx);
+    if (!defaultExecutor) {
+        defaultExecutor = std::make_shared<LoggerExecutor>();
+    }
+
+    return defaultExecutor;
+}
+
+LOGGER_MAYBE_UNUSED void LoggerExecutor::setDefault(std::shared_ptr<LoggerExecutor> executor) {
+    std::unique_lock<std::mutex> lock(defaultMtx);
+    defaultExecutor = std::move(executor);
+}
+
+void LoggerExecutor::add(Logger *logger) {
+    std::unique_lock<std::mutex> lock(mtx);
+    loggers.push_back(logger);
+}
+
+void LoggerExecutor::remove(Logger *logger) {
+    std::unique_lock<std::mutex> lock(mtx);
+    idle.wait(lock, [this, logger] {
+        return std::find(busy.begin(), busy.end(), logger) == busy.end();
+    });
+
+    ready.erase(std::remove(ready.begin(), ready.end(), logger), ready.end());
+    loggers.erase(std::remove(loggers.begin(), loggers.end(), logger), loggers.end());
+}
+
+void LoggerExecutor::schedule(Logger *logger) {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        ready.push_back(logger);
+    }
+
+    cv.notify_one();
+}
+
+void LoggerExecutor::thread_main() {
+#ifdef __linux__
+    if (!cpuAffinity.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpuAffinity) {
+            CPU_SET(cpu, &set);
+        }
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            std::cerr << "Could not set the CPU affinity of a logger thread" << std::endl;
+        }
+    }
+
+    if (niceLevel != 0 && setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), niceLevel) != 0) {
+        perror("Could not set the nice level of a logger thread");
+    }
+#endif
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        if (ready.empty()) {
+            if (!run) break;
+
+            // Only wake up periodically if a logger is waiting to
+            // write the summary of a repeated message
+            const bool timed = std::any_of(loggers.begin(), loggers.end(), [](Logger *logger) {
+                return logger->coalesce.load(std::memory_order_relaxed);
+            });
+
+            if (!timed) {
+                cv.wait(lock);
+            } else if (cv.wait_for(lock, std::chrono::milliseconds(100)) == std::cv_status::timeout) {
+                for (size_t i = 0; i < loggers.size(); i++) {
+                    Logger *logger = loggers[i];
+                    if (std::find(busy.begin(), busy.end(), logger) != busy.end()) continue;
+
+                    busy.push_back(logger);
+                    lock.unlock();
+                    logger->flush_repeated();
+                    lock.lock();
+                    busy.erase(std::find(busy.begin(), busy.end(), logger));
+                    idle.notify_all();
+                }
+            }
+
+            continue;
+        }
+
+        Logger *logger = ready.front();
+        ready.pop_front();
+        busy.push_back(logger);
+        lock.unlock();
+
+        const bool pending = logger->drain(batch_size);
+
+        lock.lock();
+        busy.erase(std::find(busy.begin(), busy.end(), logger));
+        if (pending) {
+            // Continue with the other loggers first
+            ready.push_back(logger);
+        }
+
+        idle.notify_all();
+    }
+}
+
+LoggerExecutor::~LoggerExecutor() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        run = false;
+    }
+
+    cv.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+std::mutex LoggerExecutor::defaultMtx;
+
+std::shared_ptr<LoggerExecutor> LoggerExecutor::defaultExecutor = nullptr;
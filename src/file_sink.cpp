@@ -0,0 +1,254 @@
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    constexpr size_t block_size = 4096;
+
+    size_t round_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool write_fully(int fd, const char *data, size_t size, size_t offset) {
+        while (size > 0) {
+            ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) continue;
+            // A write of zero bytes would never make progress
+            if (written <= 0) {
+                return false;
+            }
+
+            data += written;
+            offset += written;
+            size -= written;
+        }
+
+        return true;
+    }
+}
+
+DirectFileSink::DirectFileSink(const std::string &fileName, DirectFileOptions options) : fd(-1), options(options),
+                                                                                alignment(1), buffers{},
+                                                                                active(0), activeSize(0),
+                                                                                activeWritten(0), activeOffset(0),
+                                                                                pending(nullptr), pendingSize(0),
+                                                                                pendingOffset(0), pendingFlushed(false),
+                                                                                flushRequested(false), run(true),
+                                                                                mtx(), cv(), ioThread(), index() {
+    int flags = O_RDWR | O_CREAT | (options.append ? 0 : O_TRUNC);
+#ifdef O_DIRECT
+    if (options.directIO) {
+        fd = open(fileName.c_str(), flags | O_DIRECT, 0644);
+        if (fd >= 0) {
+            alignment = block_size;
+        }
+    }
+#endif
+
+    if (fd < 0) {
+        this->options.directIO = false;
+        fd = open(fileName.c_str(), flags, 0644);
+        if (fd < 0) {
+            perror("Could not open the log file");
+            return;
+        }
+    }
+
+    this->options.bufferSize = round_up(std::max<size_t>(options.bufferSize, block_size), block_size);
+    try {
+        init(fileName);
+    } catch (...) {
+        // The destructor is not called if the constructor throws
+        for (auto buffer : buffers) {
+            free(buffer);
+        }
+
+        close(fd);
+        throw;
+    }
+}
+
+void DirectFileSink::init(const std::string &fileName) {
+    for (auto &buffer : buffers) {
+        void *ptr = nullptr;
+        if (posix_memalign(&ptr, block_size, this->options.bufferSize) != 0) {
+            throw std::bad_alloc();
+        }
+        buffer = static_cast<char *>(ptr);
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0) {
+        activeOffset = static_cast<size_t>(st.st_size);
+    }
+
+    // O_DIRECT requires aligned offsets, so re-read the partial last block
+    // of the file and write it again together with the first buffer
+    if (alignment > 1 && activeOffset % alignment != 0) {
+        size_t tail = activeOffset % alignment;
+        activeOffset -= tail;
+        if (pread(fd, buffers[active], alignment, static_cast<off_t>(activeOffset)) < static_cast<ssize_t>(tail)) {
+            perror("Could not read the end of the log file");
+        }
+        activeSize = tail;
+        activeWritten = tail;
+    }
+
+    if (options.indexBlockSize > 0) {
+        index = std::make_unique<LogIndexWriter>(fileName + ".idx", options.append, options.indexBlockSize);
+    }
+
+    ioThread = std::thread(&DirectFileSink::io_thread_main, this);
+}
+
+void DirectFileSink::write(LogLevel level, const char *_file, int line, const std::string &message) {
+    if (fd < 0) return;
+    std::unique_lock<std::mutex> lock(mtx);
+
+    if (index) {
+        index->add(activeOffset + activeSize, message.size(), level, _file, line);
+    }
+
+    const char *data = message.data();
+    size_t remaining = message.size();
+    while (remaining > 0) {
+        size_t toCopy = std::min(remaining, options.bufferSize - activeSize);
+        memcpy(buffers[active] + activeSize, data, toCopy);
+        activeSize += toCopy;
+        data += toCopy;
+        remaining -= toCopy;
+
+        if (activeSize == options.bufferSize) {
+            // Both buffers are full, this is the only case where the writer waits for the disk
+            cv.wait(lock, [this] { return pending == nullptr; });
+            submit(false);
+        }
+    }
+}
+
+void DirectFileSink::flush() {
+    if (fd < 0) return;
+    std::unique_lock<std::mutex> lock(mtx);
+
+    if (pending == nullptr) {
+        submit(true);
+    } else {
+        // Let the I/O thread pick up the buffer once it is done with the current one
+        flushRequested = true;
+    }
+}
+
+void DirectFileSink::sync() {
+    if (fd < 0) return;
+    std::unique_lock<std::mutex> lock(mtx);
+
+    cv.wait(lock, [this] { return pending == nullptr; });
+    submit(true);
+    cv.wait(lock, [this] { return pending == nullptr; });
+    lock.unlock();
+
+    fdatasync(fd);
+}
+
+void DirectFileSink::submit(bool flushed) {
+    if (activeSize == activeWritten) {
+        return;
+    }
+
+    char *buffer = buffers[active];
+    char *next = buffers[1 - active];
+    size_t writeSize = round_up(activeSize, alignment);
+    size_t tail = activeSize % alignment;
+
+    pending = buffer;
+    pendingSize = activeSize;
+    pendingOffset = activeOffset;
+    pendingFlushed = flushed;
+    flushRequested = false;
+
+    if (tail != 0) {
+        // The partial last block will be written again with the next buffer
+        memset(buffer + activeSize, 0, writeSize - activeSize);
+        memcpy(next, buffer + activeSize - tail, tail);
+    }
+
+    activeOffset += activeSize - tail;
+    activeSize = tail;
+    activeWritten = tail;
+    active = 1 - active;
+    cv.notify_all();
+}
+
+void DirectFileSink::io_thread_main() {
+    auto lastSync = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (true) {
+        cv.wait(lock, [this] { return pending != nullptr || !run; });
+        if (pending == nullptr) break;
+
+        const char *data = pending;
+        size_t size = round_up(pendingSize, alignment);
+        size_t offset = pendingOffset;
+        bool flushed = pendingFlushed;
+        lock.unlock();
+
+        if (!write_fully(fd, data, size, offset)) {
+            perror("Could not write to the log file");
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (options.syncPolicy == DATASYNC_ALWAYS || (options.syncPolicy == DATASYNC_ON_FLUSH && flushed) ||
+            (options.syncPolicy == DATASYNC_INTERVAL && now - lastSync >= options.syncInterval)) {
+            fdatasync(fd);
+            lastSync = now;
+        }
+
+        lock.lock();
+        pending = nullptr;
+        if (flushRequested) {
+            submit(true);
+        }
+        cv.notify_all();
+    }
+}
+
+DirectFileSink::~DirectFileSink() {
+    if (fd < 0) return;
+
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return pending == nullptr; });
+        size_t fileSize = activeOffset + activeSize;
+        submit(true);
+        cv.wait(lock, [this] { return pending == nullptr; });
+
+        run = false;
+        cv.notify_all();
+        lock.unlock();
+        ioThread.join();
+
+        // Remove the padding of the last block written using O_DIRECT
+        if (alignment > 1 && ftruncate(fd, static_cast<off_t>(fileSize)) != 0) {
+            perror("Could not truncate the log file");
+        }
+    }
+
+    if (options.syncPolicy != DATASYNC_NONE) {
+        fdatasync(fd);
+    }
+
+    close(fd);
+    for (auto buffer : buffers) {
+        free(buffer);
+    }
+}
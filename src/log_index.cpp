@@ -0,0 +1,183 @@
+#include <iostream>
+#include <limits>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    constexpr char index_magic[8] = {'L', 'O', 'G', 'I', 'D', 'X', '1', '\0'};
+
+    // Version 2 writes the records of a block after its entry
+    constexpr uint32_t index_version = 2;
+
+    struct index_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entrySize;
+    };
+
+    bool is_valid(const index_header &header) {
+        return memcmp(header.magic, index_magic, sizeof(index_magic)) == 0 && header.version == index_version &&
+               header.entrySize == sizeof(LogIndexEntry);
+    }
+
+    uint64_t hash_call_site(const char *_file, int line) {
+        // FNV-1a over the file name and the line number
+        uint64_t hash = 14695981039346656037ull;
+        for (const char *c = _file; *c != '\0'; c++) {
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        }
+
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((static_cast<uint32_t>(line) >> (i * 8)) & 0xff)) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    uint32_t fold_call_site(const char *_file, int line) {
+        const uint64_t hash = hash_call_site(_file, line);
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+bool LogIndexRecord::isFrom(const char *_file, int line) const {
+    return callSite == fold_call_site(_file, line);
+}
+
+bool LogIndexEntry::mayContain(const char *_file, int line) const {
+    const uint64_t hash = hash_call_site(_file, line);
+    for (int i = 0; i < 3; i++) {
+        const auto bit = static_cast<uint8_t>(hash >> (i * 8));
+        if ((callSites[bit / 64] & (1ull << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void LogIndexEntry::addCallSite(const char *_file, int line) {
+    const uint64_t hash = hash_call_site(_file, line);
+    for (int i = 0; i < 3; i++) {
+        const auto bit = static_cast<uint8_t>(hash >> (i * 8));
+        callSites[bit / 64] |= 1ull << (bit % 64);
+    }
+}
+
+LogIndexWriter::LogIndexWriter(const std::string &fileName, bool append, size_t blockSize) : file(nullptr),
+                                                                                             blockSize(blockSize),
+                                                                                             current(),
+                                                                                             records() {
+    if (append) {
+        // Never append to an index written in another format, start a new one instead
+        FILE *existing = fopen(fileName.c_str(), "rb");
+        if (existing != nullptr) {
+            index_header header{};
+            const bool valid = fread(&header, sizeof(header), 1, existing) == 1 && is_valid(header);
+            fseek(existing, 0, SEEK_END);
+            append = valid || ftell(existing) == 0;
+            fclose(existing);
+        }
+    }
+
+    file = fopen(fileName.c_str(), append ? "ab" : "wb");
+    if (file == nullptr) {
+        std::cerr << "Could not open " << fileName << " file!" << std::endl;
+        return;
+    }
+
+    if (ftell(file) == 0) {
+        index_header header{};
+        memcpy(header.magic, index_magic, sizeof(index_magic));
+        header.version = index_version;
+        header.entrySize = sizeof(LogIndexEntry);
+        fwrite(&header, sizeof(header), 1, file);
+        fflush(file);
+    }
+}
+
+void LogIndexWriter::add(uint64_t offset, size_t size, LogLevel level, const char *_file, int line) {
+    if (file == nullptr) return;
+
+    const int64_t time = now_ms();
+    // The offset and time of a record are stored relative to its block
+    if (current.count > 0 && (offset + size - current.offset > std::numeric_limits<uint32_t>::max() ||
+                              time - current.firstTime > std::numeric_limits<uint32_t>::max())) {
+        write_entry();
+    }
+
+    if (current.count == 0) {
+        current.offset = offset;
+        current.firstTime = time;
+    }
+
+    current.size = offset + size - current.offset;
+    current.lastTime = time;
+    current.count++;
+    current.levels |= 1u << level;
+    current.addCallSite(_file, line);
+
+    LogIndexRecord record{};
+    record.offset = static_cast<uint32_t>(offset - current.offset);
+    record.size = static_cast<uint32_t>(std::min<uint64_t>(size, std::numeric_limits<uint32_t>::max()));
+    // The system clock may go backwards
+    record.time = static_cast<uint32_t>(std::max<int64_t>(time - current.firstTime, 0));
+    record.level = static_cast<uint32_t>(level);
+    record.callSite = fold_call_site(_file, line);
+    records.push_back(record);
+
+    if (current.size >= blockSize) {
+        write_entry();
+    }
+}
+
+void LogIndexWriter::write_entry() {
+    if (current.count == 0) return;
+
+    fwrite(&current, sizeof(current), 1, file);
+    fwrite(records.data(), sizeof(LogIndexRecord), records.size(), file);
+    fflush(file);
+    current = LogIndexEntry();
+    records.clear();
+}
+
+std::vector<LogIndexEntry> LogIndexWriter::read(const std::string &fileName, std::vector<LogIndexRecord> *records) {
+    std::vector<LogIndexEntry> entries;
+    FILE *in = fopen(fileName.c_str(), "rb");
+    if (in == nullptr) return entries;
+
+    index_header header{};
+    if (fread(&header, sizeof(header), 1, in) == 1 && is_valid(header)) {
+        LogIndexEntry entry{};
+        std::vector<LogIndexRecord> blockRecords;
+        // A partially written entry at the end of the index is ignored
+        while (fread(&entry, sizeof(entry), 1, in) == 1) {
+            blockRecords.resize(entry.count);
+            if (fread(blockRecords.data(), sizeof(LogIndexRecord), entry.count, in) != entry.count) break;
+
+            entries.push_back(entry);
+            if (records != nullptr) {
+                records->insert(records->end(), blockRecords.begin(), blockRecords.end());
+            }
+        }
+    }
+
+    fclose(in);
+    return entries;
+}
+
+LogIndexWriter::~LogIndexWriter() {
+    if (file != nullptr) {
+        write_entry();
+        fclose(file);
+    }
+}
@@ -0,0 +1,145 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    bool contains(const char *begin, const char *end, const std::string &needle) {
+        return memmem(begin, end - begin, needle.data(), needle.size()) != nullptr;
+    }
+
+    /**
+     * Ask the kernel to read a part of a mapped file ahead
+     */
+    void will_need(const char *data, uint64_t begin, uint64_t end) {
+        const uint64_t page = begin & ~static_cast<uint64_t>(4095);
+        madvise(const_cast<char *>(data) + page, end - page, MADV_WILLNEED);
+    }
+}
+
+LogQuery::LogQuery(std::string logFile, LogQueryOptions options) : logFile(std::move(logFile)),
+                                                                   options(std::move(options)), stats() {
+    if (this->options.indexFile.empty()) {
+        this->options.indexFile = this->logFile + ".idx";
+    }
+}
+
+long long LogQuery::run(FILE *out) {
+    stats = LogQueryStats();
+    int fd = open(logFile.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    const auto size = static_cast<uint64_t>(st.st_size);
+    stats.fileSize = size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return -1;
+
+    const char *data = static_cast<const char *>(mapped);
+    std::vector<LogIndexRecord> records;
+    const std::vector<LogIndexEntry> entries = LogIndexWriter::read(options.indexFile, &records);
+    stats.blocks = entries.size();
+
+    long long matches = 0;
+    uint64_t indexed = 0;
+    size_t firstRecord = 0;
+    for (const auto &entry : entries) {
+        const size_t recordCount = entry.count;
+        firstRecord += recordCount;
+        if (entry.offset >= size) continue;
+
+        // Messages written before the index was created
+        if (entry.offset > indexed) {
+            matches += scan_unindexed(data + indexed, data + entry.offset, out);
+        }
+
+        indexed = std::max(indexed, entry.offset + entry.size);
+        if (entry.lastTime < options.from || entry.firstTime > options.to ||
+            (options.levels != 0 && (entry.levels & options.levels) == 0) ||
+            (!options.siteFile.empty() && !entry.mayContain(options.siteFile.c_str(), options.siteLine))) {
+            continue;
+        }
+
+        const uint64_t end = std::min(size, entry.offset + entry.size);
+        will_need(data, entry.offset, end);
+        stats.scannedBlocks++;
+        stats.scannedBytes += end - entry.offset;
+
+        for (size_t i = firstRecord - recordCount; i < firstRecord; i++) {
+            const LogIndexRecord &record = records[i];
+            const uint64_t begin = entry.offset + record.offset;
+            const int64_t time = entry.firstTime + record.time;
+            if (begin + record.size > end || time < options.from || time > options.to ||
+                (options.levels != 0 && (options.levels & (1u << record.level)) == 0) ||
+                (!options.siteFile.empty() && !record.isFrom(options.siteFile.c_str(), options.siteLine)) ||
+                (!options.pattern.empty() && !contains(data + begin, data + begin + record.size, options.pattern))) {
+                continue;
+            }
+
+            fwrite(data + begin, 1, record.size, out);
+            matches++;
+        }
+    }
+
+    // Messages which have not been indexed yet, e.g. after a crash
+    if (indexed < size) {
+        matches += scan_unindexed(data + indexed, data + size, out);
+    }
+
+    munmap(mapped, size);
+    return matches;
+}
+
+const LogQueryStats &LogQuery::getStats() const {
+    return stats;
+}
+
+bool LogQuery::has_index_filters() const {
+    return options.from != INT64_MIN || options.to != INT64_MAX || options.levels != 0 || !options.siteFile.empty();
+}
+
+long long LogQuery::scan_unindexed(const char *begin, const char *end, FILE *out) {
+    // Without an index there is nothing to match the time, level or call site against
+    if (has_index_filters()) {
+        stats.skippedBytes += end - begin;
+        return 0;
+    }
+
+    stats.scannedBlocks++;
+    stats.scannedBytes += end - begin;
+
+    // Lines are split using memchr and searched using memmem,
+    // both of which are vectorized by the C library
+    long long matches = 0;
+    while (begin < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(begin, '\n', end - begin));
+        lineEnd = lineEnd == nullptr ? end : lineEnd + 1;
+
+        if (options.pattern.empty() || contains(begin, lineEnd, options.pattern)) {
+            fwrite(begin, 1, lineEnd - begin, out);
+            matches++;
+        }
+
+        begin = lineEnd;
+    }
+
+    return matches;
+}
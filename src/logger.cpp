@@ -1,5 +1,13 @@
 #include <iostream>
-#include <future>
+#include <charconv>
+#include <algorithm>
+#include <limits>
+
+#ifdef _WIN32
+#   include <io.h>
+#else
+#   include <unistd.h>
+#endif
 
 #define LOGGER_NO_UNDEF
 
@@ -7,6 +15,26 @@
 
 using namespace markusjx::logging;
 
+namespace {
+    // The number of payload bytes encoded and written at once. A multiple of the
+    // 57 bytes of a base64 line and the 16 bytes of a hex dump line, so only the
+    // last chunk of a payload may end with a short line
+    constexpr size_t payload_chunk_size = 57 * 64;
+    static_assert(payload_chunk_size % 57 == 0 && payload_chunk_size % 16 == 0,
+                  "Payload chunks must consist of whole lines");
+
+    /**
+     * The header of a message written to the spill file of a logger
+     */
+    struct spill_record {
+        const char *_file;
+        int line;
+        LogLevel logLevel;
+        bool to_stderr;
+        size_t size;
+    };
+}
+
 LOGGER_MAYBE_UNUSED void LoggerOptions::setTimeFormat(loggerTimeFormat fmt) {
     time_fmt = fmt;
 }
@@ -15,32 +43,51 @@ LOGGER_MAYBE_UNUSED void LoggerOptions::setLogFormat(const char *fmt) {
     log_fmt = fmt;
 }
 
-void LoggerOptions::formatOption(std::stringstream &ss, char option, const char *file, int line, const char *method,
-                                 const char *logLevel, const std::string &message) {
+void LoggerOptions::formatOption(std::string &out, char option, const char *file, int line, const char *method,
+                                 const char *logLevel, const std::string &message, const char *category,
+                                 uint32_t threadId, const LogContext::snapshot *context) {
     switch (option) {
         case 't':
-            ss << LoggerUtils::currentDateTime();
+            LoggerUtils::appendDateTime(out);
             break;
         case 'f':
-            ss << file;
+            out.append(file);
             break;
         case 'l':
-            ss << line;
+            LoggerUtils::appendNumber(out, line);
             break;
         case 'M':
-            ss << method;
+            out.append(method);
             break;
         case 'p':
-            ss << logLevel;
+            out.append(logLevel);
             break;
         case 'm':
-            ss << message;
+            out.append(message);
+            break;
+        case 'c':
+            out.append(category);
+            break;
+        case 'T':
+            LoggerUtils::appendNumber(out, threadId);
+            break;
+        case 'N':
+            if (context != nullptr && !context->threadName.empty()) {
+                out.append(context->threadName);
+            } else {
+                LoggerUtils::appendNumber(out, threadId);
+            }
+            break;
+        case 'X':
+            if (context != nullptr) {
+                out.append(context->values);
+            }
             break;
         case 'n':
-            ss << std::endl;
+            out.push_back('\n');
             break;
         case '%':
-            ss << '%';
+            out.push_back('%');
             break;
         default:
             break;
@@ -48,25 +95,31 @@ void LoggerOptions::formatOption(std::stringstream &ss, char option, const char
 }
 
 std::string LoggerOptions::formatMessage(const char *file, int line, const char *method, const char *logLevel,
-                                         const std::string &message) {
-    std::stringstream ss;
-    const std::string format(log_fmt);
-
-    size_t last = 0;
-    while (last < std::string::npos) {
-        size_t pos = format.find('%', last);
-        if (pos == std::string::npos) {
-            ss << format.substr(last);
+                                         const std::string &message, const char *category, uint32_t threadId,
+                                         const LogContext::snapshot *context) {
+    if (threadId == 0) {
+        threadId = LoggerUtils::threadId();
+    }
+
+    std::string out;
+    out.reserve(message.size() + 64);
+
+    const char *last = log_fmt;
+    while (true) {
+        const char *pos = strchr(last, '%');
+        if (pos == nullptr) {
+            out.append(last);
             break;
         } else {
-            ss << format.substr(last, pos - last);
+            out.append(last, pos - last);
+            if (pos[1] == '\0') break;
 
-            formatOption(ss, format[pos + 1], file, line, method, logLevel, message);
+            formatOption(out, pos[1], file, line, method, logLevel, message, category, threadId, context);
             last = pos + 2;
         }
     }
 
-    return ss.str();
+    return out;
 }
 
 LoggerOptions::loggerTimeFormat LoggerOptions::time_fmt = {"%d-%m-%Y %T", 20};
@@ -74,24 +127,41 @@ LoggerOptions::loggerTimeFormat LoggerOptions::time_fmt = {"%d-%m-%Y %T", 20};
 const char *LoggerOptions::log_fmt = "[%t] [%f:%l] [%p] %m%n";
 
 std::string LoggerUtils::currentDateTime() {
-    time_t now = time(nullptr);
-    struct tm tm{};
-
     std::string buf;
-    buf.resize(LoggerOptions::time_fmt.sizeInBytes);
+    appendDateTime(buf);
+    return buf;
+}
+
+void LoggerUtils::appendDateTime(std::string &out) {
+    // strftime is expensive compared to the rest of the formatter, so
+    // cache the formatted time until the second or the format changes
+    thread_local time_t lastTime = -1;
+    thread_local const char *lastFormat = nullptr;
+    thread_local std::string cached;
+
+    time_t now = time(nullptr);
+    if (now != lastTime || lastFormat != LoggerOptions::time_fmt.format) {
+        struct tm tm{};
 #ifdef LOGGER_WINDOWS
-    localtime_s(&tm, &now);
+        localtime_s(&tm, &now);
 #else
-    tm = *localtime(&now);
+        localtime_r(&now, &tm);
 #endif
-    strftime(const_cast<char *>(buf.data()), LoggerOptions::time_fmt.sizeInBytes, LoggerOptions::time_fmt.format, &tm);
+        cached.resize(LoggerOptions::time_fmt.sizeInBytes);
+        size_t written = strftime(cached.data(), cached.size(), LoggerOptions::time_fmt.format, &tm);
+        cached.resize(written);
 
-    buf.resize(strlen(buf.c_str()));
-    return buf;
+        lastTime = now;
+        lastFormat = LoggerOptions::time_fmt.format;
+    }
+
+    out.append(cached);
 }
 
-const char *LoggerUtils::removeSlash(const char *str) {
-    return strrchr(str, slash) + 1;
+void LoggerUtils::appendNumber(std::string &out, long long value) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr - buf);
 }
 
 LoggerUtils::LoggerStream::LoggerStream(std::function<void(std::string)> callback, LoggerMode mode, bool disabled)
@@ -110,11 +180,24 @@ LoggerUtils::LoggerStream::~LoggerStream() {
 // Logger class ==========================================
 
 Logger::log_message::log_message(const char *level, const char *_file, int line, const char *method,
-                                 std::string message, LogLevel logLevel, bool to_stderr)
+                                 std::string message, LogLevel logLevel, bool to_stderr, const char *category)
         : level(level), _file(_file), line(line), method(method), message(std::move(message)), to_stderr(to_stderr),
-          logLevel(logLevel) {}
+          logLevel(logLevel), category(category), stackTrace(), threadId(0), context(), payload(),
+          payloadEncoding(PAYLOAD_HEX), queuedSize(0) {}
+
+bool Logger::is_enabled(const log_message &message) const {
+    // The level of categorized messages has already been checked against their category
+    return message.category != nullptr || message.logLevel <= level;
+}
 
-Logger::Logger() : mtx(), messageQueue(), run(false), writeThread() {
+Logger::Logger() : mtx(), executor(), scheduled(false), messageQueues(), queueCapacity{0, 0, 0},
+                   droppedMessages{0, 0, 0}, budgetDropped{0, 0, 0}, droppedSpans(0), coalesce(false),
+                   stackTraceFrames(0), coalesceWindow(1000),
+                   repeatMtx(), repeatState(),
+                   sinks(std::make_shared<const std::vector<std::shared_ptr<LogSink>>>()), commitState(), syncMtx(), syncCondition(),
+                   writtenSequence(0), syncedSequence(0), syncing(false), budgetPolicy(BUDGET_BLOCK),
+                   budgetTimeout(100), queuedBytes(0), spillState(), spanQueue(), traceMtx(),
+                   traceFile(nullptr), tracing(false), traceFormat(TRACE_JSON), firstTraceEvent(true) {
     _mode = MODE_CONSOLE;
     level = LogLevel::DEBUG;
     file = nullptr;
@@ -123,52 +206,78 @@ Logger::Logger() : mtx(), messageQueue(), run(false), writeThread() {
     init(nullptr, nullptr);
 }
 
-Logger::Logger(LoggerMode mode, LogLevel lvl, SyncMode syncMode, const char *fileName, const char *fileMode) : mtx(),
-                                                                                                               messageQueue(),
-                                                                                                               run(false),
-                                                                                                               writeThread() {
+Logger::Logger(LoggerMode mode, LogLevel lvl, SyncMode syncMode, const char *fileName, const char *fileMode,
+               std::shared_ptr<LoggerExecutor> executor) : mtx(), executor(std::move(executor)), scheduled(false),
+                                                           messageQueues(), queueCapacity{0, 0, 0},
+                                                           droppedMessages{0, 0, 0}, budgetDropped{0, 0, 0},
+                                                           droppedSpans(0), coalesce(false),
+                                                           stackTraceFrames(0),
+                                                           coalesceWindow(1000), repeatMtx(), repeatState(),
+                                                           sinks(std::make_shared<const std::vector<std::shared_ptr<LogSink>>>()),
+                                                           commitState(), syncMtx(), syncCondition(),
+                                                           writtenSequence(0), syncedSequence(0), syncing(false),
+                                                           budgetPolicy(BUDGET_BLOCK), budgetTimeout(100),
+                                                           queuedBytes(0), spillState(), spanQueue(), traceMtx(), traceFile(nullptr),
+                                                           tracing(false), traceFormat(TRACE_JSON),
+                                                           firstTraceEvent(true) {
     _mode = mode;
     level = lvl;
     file = nullptr;
     sync = syncMode;
 
     if (syncMode == ASYNC) {
-        run = true;
-        writeThread = std::thread([this] {
-            while(run || !messageQueue.empty()) {
-                std::unique_lock<std::mutex> lock(mtx);
-                if (!messageQueue.empty()) {
-                    log_message msg = messageQueue.front();
-                    messageQueue.pop_front();
-                    lock.unlock();
-
-                    write_log_impl(msg);
-                } else {
-                    lock.unlock();
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                }
-            }
-        });
+        if (!this->executor) {
+            this->executor = LoggerExecutor::getDefault();
+        }
+
+        this->executor->add(this);
     }
 
     init(fileName, fileMode);
 }
 
+#ifndef LOGGER_INLINE_FAST_PATH
 void Logger::_debug(const char *_file, int line, const char *method, const std::string &message) {
+    if (DEBUG > level) return;
     write_log_message(log_message("DEBUG", _file, line, method, message, DEBUG));
 }
 
 void Logger::_error(const char *_file, int line, const char *method, const std::string &message) {
+    if (ERROR > level) return;
     write_log_message(log_message("ERROR", _file, line, method, message, ERROR, true));
 }
 
+void Logger::_warning(const char *_file, int line, const char *method, const std::string &message) {
+    if (WARNING > level) return;
+    write_log_message(log_message("WARN", _file, line, method, message, WARNING, true));
+}
+#endif //LOGGER_INLINE_FAST_PATH
+
+// The public functions writing errors capture the stack trace themselves and
+// skip their own frame, so the trace starts at the error site
 void Logger::_error(const char *_file, int line, const char *method, std::string message, const std::exception &e) {
-    message = message.append(" ").append(e.what());
-    write_log_message(log_message("ERROR", _file, line, method, message, ERROR, true));
+    if (ERROR > level) return;
+
+    const unsigned frames = stackTraceFrames.load(std::memory_order_relaxed);
+    write_error(_file, line, method, std::move(message), e, nullptr,
+                frames > 0 ? LoggerUtils::captureStackTrace(frames, 1) : std::vector<void *>());
 }
 
-void Logger::_warning(const char *_file, int line, const char *method, const std::string &message) {
-    write_log_message(log_message("WARN", _file, line, method, message, WARNING, true));
+void Logger::_error(const LogCategory &category, const char *_file, int line, const char *method,
+                    const std::string &message, const std::exception &e) {
+    if (!category.isEnabled(ERROR, level)) return;
+
+    const unsigned frames = stackTraceFrames.load(std::memory_order_relaxed);
+    write_error(_file, line, method, message, e, category.getName().c_str(),
+                frames > 0 ? LoggerUtils::captureStackTrace(frames, 1) : std::vector<void *>());
+}
+
+void Logger::write_error(const char *_file, int line, const char *method, std::string message,
+                         const std::exception &e, const char *category, std::vector<void *> stackTrace) {
+    log_message msg("ERROR", _file, line, method, message.append(" ").append(e.what()), ERROR, true, category);
+    msg.stackTrace = std::move(stackTrace);
+
+    write_log_message(std::move(msg));
 }
 
 LoggerUtils::LoggerStream Logger::_debugStream(const char *_file, int line, const char *method) {
@@ -189,52 +298,766 @@ LoggerUtils::LoggerStream Logger::_errorStream(const char *_file, int line, cons
     }, _mode, level == NONE);
 }
 
-void Logger::write_log_message(const log_message &message) {
-    if (message.logLevel <= level) {
-        if (sync == SYNC) {
-            std::unique_lock<std::mutex> lock(mtx);
-            write_log_impl(message);
-        } else if (sync == ASYNC) {
-            std::unique_lock<std::mutex> lock(mtx);
-            messageQueue.push_back(message);
+void Logger::write_payload(const char *lvl, const char *_file, int line, const char *method,
+                           const std::string &message, LogLevel logLevel, bool to_stderr, const void *data,
+                           size_t size, PayloadEncoding encoding) {
+    log_message msg(lvl, _file, line, method, message, logLevel, to_stderr);
+    // Only the raw bytes are queued, they are encoded when the message is written
+    msg.payload.assign(static_cast<const char *>(data), size);
+    msg.payloadEncoding = encoding;
+
+    write_log_message(std::move(msg));
+}
+
+void Logger::write_log_message(log_message message) {
+    if (is_enabled(message)) {
+        // Only messages which are written pay for capturing their thread and context
+        message.threadId = LoggerUtils::threadId();
+        message.context = LogContext::current();
+
+        // Messages with a payload are never coalesced, their payloads may differ
+        if (coalesce.load(std::memory_order_relaxed) && message.payload.empty()) {
+            write_coalesced(std::move(message));
         } else {
-            write_log_impl(message);
+            dispatch_log_message(std::move(message));
+        }
+    }
+}
+
+void Logger::write_coalesced(log_message message) {
+    // Only compare the call site, the hash and the size of the message,
+    // identical messages from the same call site are never compared char by char
+    const size_t hash = std::hash<std::string>()(message.message);
+    const auto now = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(repeatMtx);
+    repeat_state &state = repeatState;
+    if (state.count >= 0 && state.hash == hash && state.size == message.message.size() &&
+        state._file == message._file && state.line == message.line && state.logLevel == message.logLevel &&
+        state.category == message.category) {
+        state.count++;
+        if (now - state.start >= coalesceWindow) {
+            std::vector<log_message> pending = take_repeated_summary();
+            state.start = now;
+            lock.unlock();
+
+            dispatch_log_messages(std::move(pending));
+        }
+
+        return;
+    }
+
+    std::vector<log_message> pending = take_repeated_summary();
+    state.hash = hash;
+    state.size = message.message.size();
+    state._file = message._file;
+    state.line = message.line;
+    state.method = message.method;
+    state.level = message.level;
+    state.logLevel = message.logLevel;
+    state.to_stderr = message.to_stderr;
+    state.category = message.category;
+    state.threadId = message.threadId;
+    state.context = message.context;
+    state.count = 0;
+    state.start = now;
+    pending.push_back(std::move(message));
+    lock.unlock();
+
+    dispatch_log_messages(std::move(pending));
+}
+
+std::vector<Logger::log_message> Logger::take_repeated_summary() {
+    std::vector<log_message> summary;
+    if (repeatState.count <= 0) return summary;
+
+    std::string text("Last message repeated ");
+    LoggerUtils::appendNumber(text, repeatState.count);
+    text.append(repeatState.count == 1 ? " time" : " times");
+    repeatState.count = 0;
+
+    // The summary may be written by any thread, it belongs to the thread of the repeated message
+    summary.emplace_back(repeatState.level, repeatState._file, repeatState.line, repeatState.method, text,
+                         repeatState.logLevel, repeatState.to_stderr, repeatState.category);
+    summary.back().threadId = repeatState.threadId;
+    summary.back().context = repeatState.context;
+    return summary;
+}
+
+void Logger::dispatch_log_messages(std::vector<log_message> messages) {
+    // Called without holding repeatMtx, so a dispatch waiting for the
+    // write thread never keeps it from writing a summary
+    for (auto &message : messages) {
+        dispatch_log_message(std::move(message));
+    }
+}
+
+void Logger::flush_repeated() {
+    if (coalesce.load(std::memory_order_relaxed)) {
+        std::unique_lock<std::mutex> lock(repeatMtx);
+        if (repeatState.count > 0 && std::chrono::steady_clock::now() - repeatState.start >= coalesceWindow) {
+            std::vector<log_message> pending = take_repeated_summary();
+            repeatState.start = std::chrono::steady_clock::now();
+            lock.unlock();
+
+            dispatch_log_messages(std::move(pending));
+        }
+    }
+}
+
+void Logger::setCoalesceRepeated(bool enabled, std::chrono::milliseconds window) {
+    std::unique_lock<std::mutex> lock(repeatMtx);
+    std::vector<log_message> pending;
+    if (!enabled) {
+        pending = take_repeated_summary();
+        repeatState.count = -1;
+    }
+
+    coalesceWindow = window;
+    coalesce = enabled;
+    lock.unlock();
+
+    dispatch_log_messages(std::move(pending));
+}
+
+void Logger::dispatch_log_message(log_message message) {
+    const int lane = message.logLevel - 1;
+    if (sync == ASYNC) {
+        const size_t size = queued_size(message);
+        const bool reserved = LogMemoryBudget::try_reserve(size);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        if (queueCapacity[lane] != 0 && messageQueues[lane].size() >= queueCapacity[lane]) {
+            if (reserved) LogMemoryBudget::release(size);
+            droppedMessages[lane]++;
+            return;
+        }
+
+        if (!reserved || spillState.pending > 0) {
+            if (reserved) LogMemoryBudget::release(size);
+            if (!reserve_queue_memory(lock, message, size)) {
+                lock.unlock();
+
+                // Write the spilled message or the summary of dropped messages
+                if (!scheduled.exchange(true)) {
+                    executor->schedule(this);
+                }
+
+                return;
+            }
+        }
+
+        // The exact number of reserved bytes is released once the message has been written
+        message.queuedSize = size;
+        messageQueues[lane].push_back(std::move(message));
+        queuedBytes += size;
+        commitState.enqueued[lane]++;
+        lock.unlock();
+
+        if (!scheduled.exchange(true)) {
+            executor->schedule(this);
         }
+
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
+    if (sync == SYNC) {
+        lock.lock();
+    }
+
+    write_log_impl(message);
+    const uint64_t sequence = ++writtenSequence;
+    const Durability durability = commitState.durability[lane].load(std::memory_order_relaxed);
+    if (durability == DURABILITY_SYNC) {
+        if (lock.owns_lock()) {
+            lock.unlock();
+        }
+
+        sync_written(sequence);
+    } else if (durability == DURABILITY_FLUSH) {
+        commit(DURABILITY_FLUSH);
+    } else {
+        flush_sinks();
     }
 }
 
 void Logger::write_log_impl(const log_message &message) {
-    std::string formatted;
-    if (_mode != MODE_NONE && level >= message.logLevel) {
-        formatted = LoggerOptions::formatMessage(message._file, message.line, message.method,
-                                                 message.level, message.message);
+    if (_mode == MODE_NONE || !is_enabled(message)) return;
+    write_formatted(message.logLevel, message._file, message.line, message.to_stderr, format_message(message));
+
+    // Large payloads are encoded and written in chunks
+    std::string chunk;
+    for (size_t offset = 0; offset < message.payload.size(); offset += payload_chunk_size) {
+        chunk.clear();
+        append_payload(chunk, message, offset, std::min(payload_chunk_size, message.payload.size() - offset));
+        write_formatted(message.logLevel, message._file, message.line, message.to_stderr, chunk);
+    }
+}
+
+void Logger::append_payload(std::string &out, const log_message &message, size_t offset, size_t size) {
+    const char *data = message.payload.data() + offset;
+    if (message.payloadEncoding == PAYLOAD_BASE64) {
+        // 57 bytes are encoded into one line of 76 characters
+        for (size_t i = 0; i < size; i += 57) {
+            out.append("    ");
+            LoggerUtils::appendBase64(out, data + i, std::min<size_t>(57, size - i));
+            out.push_back('\n');
+        }
+    } else {
+        LoggerUtils::appendHexDump(out, data, size, offset);
     }
+}
+
+std::string Logger::format_message(const log_message &message) {
+    const char *category = message.category == nullptr ? "" : message.category;
+    if (message.stackTrace.empty()) {
+        return LoggerOptions::formatMessage(message._file, message.line, message.method, message.level,
+                                            message.message, category, message.threadId, message.context.get());
+    } else {
+        std::string text(message.message);
+        LoggerUtils::appendStackTrace(text, message.stackTrace);
+        return LoggerOptions::formatMessage(message._file, message.line, message.method, message.level, text,
+                                            category, message.threadId, message.context.get());
+    }
+}
 
-    if (file != nullptr && (_mode == MODE_FILE || _mode == MODE_BOTH) && level >= message.logLevel) {
+void Logger::write_formatted(LogLevel logLevel, const char *_file, int line, bool to_stderr,
+                             const std::string &formatted) {
+    if (file != nullptr && (_mode == MODE_FILE || _mode == MODE_BOTH)) {
         fprintf(this->file, "%s", formatted.c_str());
     }
 
-    if ((_mode == MODE_BOTH || _mode == MODE_CONSOLE) && level >= message.logLevel) {
-        if (message.to_stderr) {
+    if (_mode == MODE_BOTH || _mode == MODE_CONSOLE) {
+        if (to_stderr) {
             fprintf(stderr, "%s", formatted.c_str());
         } else {
             printf("%s", formatted.c_str());
         }
     }
+
+    const auto current = std::atomic_load(&sinks);
+    for (const auto &sink : *current) {
+        sink->write(logLevel, _file, line, formatted);
+    }
+}
+
+Logger::log_message *Logger::next_queued_message() {
+    // Drain the lanes in order of priority, so errors never
+    // have to wait behind a backlog of debug messages
+    for (auto &queue : messageQueues) {
+        if (!queue.empty()) {
+            return &queue.front();
+        }
+    }
+
+    return nullptr;
+}
+
+void Logger::write_dropped_summary(std::unique_lock<std::mutex> &lock) {
+    static const char *levelNames[] = {"ERROR", "WARN", "DEBUG"};
+    std::vector<std::string> summaries;
+    for (int i = 0; i < 3; i++) {
+        if (droppedMessages[i] != 0) {
+            std::string summary("Dropped ");
+            LoggerUtils::appendNumber(summary, static_cast<long long>(droppedMessages[i]));
+            summary.append(" ").append(levelNames[i]).append(" messages because the queue was full");
+            summaries.push_back(std::move(summary));
+            droppedMessages[i] = 0;
+        }
+
+        if (budgetDropped[i] != 0) {
+            std::string summary("Dropped ");
+            LoggerUtils::appendNumber(summary, static_cast<long long>(budgetDropped[i]));
+            summary.append(" ").append(levelNames[i]).append(" messages because the memory budget was exhausted");
+            summaries.push_back(std::move(summary));
+            budgetDropped[i] = 0;
+        }
+    }
+
+    if (droppedSpans != 0) {
+        std::string summary("Dropped ");
+        LoggerUtils::appendNumber(summary, static_cast<long long>(droppedSpans));
+        summary.append(" trace spans because the memory budget was exhausted");
+        summaries.push_back(std::move(summary));
+        droppedSpans = 0;
+    }
+
+    if (summaries.empty()) return;
+
+    lock.unlock();
+    for (const auto &summary : summaries) {
+        write_log_impl(log_message("WARN", LoggerUtils::removeSlash(__FILE__), __LINE__, __FUNCTION__, summary,
+                                   WARNING, true));
+    }
+    lock.lock();
+}
+
+bool Logger::drain(size_t maxMessages) {
+    std::unique_lock<std::mutex> lock(mtx);
+    Durability durability = DURABILITY_NONE;
+    for (size_t i = 0; i < maxMessages; i++) {
+        log_message *msg = next_queued_message();
+        if (msg == nullptr) {
+            // Spilled messages were written after all queued messages
+            if (!write_spilled(lock)) break;
+            continue;
+        }
+
+        log_message next = std::move(*msg);
+        const size_t size = next.queuedSize;
+        const int lane = next.logLevel - 1;
+        messageQueues[lane].pop_front();
+        durability = std::max(durability, commitState.durability[lane].load(std::memory_order_relaxed));
+        lock.unlock();
+
+        write_log_impl(next);
+        lock.lock();
+        commitState.written[lane]++;
+        queuedBytes -= size;
+        LogMemoryBudget::release(size);
+    }
+
+    while (!spanQueue.empty()) {
+        trace_span span = spanQueue.front();
+        spanQueue.pop_front();
+        lock.unlock();
+
+        write_span_impl(span);
+        lock.lock();
+        queuedBytes -= sizeof(trace_span);
+        LogMemoryBudget::release(sizeof(trace_span));
+    }
+
+    // Report dropped messages after every batch, during a sustained overload the queues never run empty
+    write_dropped_summary(lock);
+
+    // Every batch is committed while threads are waiting in flush()
+    if (commitState.syncRequests > 0) {
+        durability = DURABILITY_SYNC;
+    } else if (commitState.flushRequests > 0) {
+        durability = std::max(durability, DURABILITY_FLUSH);
+    }
+
+    if (durability != DURABILITY_NONE) {
+        uint64_t written[3];
+        std::copy(std::begin(commitState.written), std::end(commitState.written), written);
+        const uint64_t id = ++commitState.started;
+        lock.unlock();
+
+        commit(durability);
+        lock.lock();
+        std::copy(std::begin(written), std::end(written), commitState.committed);
+        commitState.finished = id;
+        queueCondition.notify_all();
+    }
+
+    if (queues_empty()) {
+        lock.unlock();
+        if (durability == DURABILITY_NONE) {
+            flush_sinks();
+        }
+        lock.lock();
+
+        // Messages written and flush() calls made while the lock was released will be handled in the next round
+        if (queues_empty() && spanQueue.empty() && commitState.finished >= commitState.requested) {
+            scheduled = false;
+            queueCondition.notify_all();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t Logger::queued_size(const log_message &message) {
+    return sizeof(log_message) + message.message.capacity() + message.payload.capacity() +
+           message.stackTrace.capacity() * sizeof(void *);
+}
+
+bool Logger::queues_empty() {
+    return next_queued_message() == nullptr && spillState.pending == 0;
+}
+
+bool Logger::reserve_queue_memory(std::unique_lock<std::mutex> &lock, const log_message &message, size_t size) {
+    const int lane = message.logLevel - 1;
+
+    // Keep the order of messages while spilled messages are pending
+    if (spillState.pending > 0) {
+        spill_message(message);
+        return false;
+    }
+
+    switch (budgetPolicy) {
+        case BUDGET_BLOCK: {
+            const auto timeout = budgetTimeout;
+            lock.unlock();
+            const bool reserved = LogMemoryBudget::reserve(size, timeout);
+            lock.lock();
+
+            if (reserved && spillState.pending == 0) {
+                return true;
+            } else if (reserved) {
+                // Another thread started spilling messages while the lock was released
+                LogMemoryBudget::release(size);
+                spill_message(message);
+                return false;
+            }
+            break;
+        }
+        case BUDGET_DROP:
+            // Drop the oldest queued messages with a lower level than this message
+            for (int i = 2; i > lane; i--) {
+                while (!messageQueues[i].empty()) {
+                    const size_t dropped = messageQueues[i].front().queuedSize;
+                    messageQueues[i].pop_front();
+                    queuedBytes -= dropped;
+                    LogMemoryBudget::release(dropped);
+                    // Dropped messages count as written for flush()
+                    commitState.written[i]++;
+                    budgetDropped[i]++;
+
+                    if (LogMemoryBudget::try_reserve(size)) {
+                        return true;
+                    }
+                }
+            }
+            break;
+        case BUDGET_SPILL:
+            spill_message(message);
+            return false;
+    }
+
+    budgetDropped[lane]++;
+    return false;
+}
+
+void Logger::spill_message(const log_message &message) {
+    if (spillState.file == nullptr) {
+        spillState.file = tmpfile();
+        spillState.readOffset = 0;
+        spillState.writeOffset = 0;
+
+        if (spillState.file == nullptr) {
+            perror("Could not create the spill file");
+            budgetDropped[message.logLevel - 1]++;
+            return;
+        }
+    }
+
+    // Messages are spilled formatted, only the file name literal is kept as a pointer
+    std::string formatted;
+    if (_mode != MODE_NONE && is_enabled(message)) {
+        formatted = format_message(message);
+        append_payload(formatted, message, 0, message.payload.size());
+    }
+
+    const spill_record record{message._file, message.line, message.logLevel, message.to_stderr,
+                              formatted.size()};
+
+    fseek(spillState.file, spillState.writeOffset, SEEK_SET);
+    if (fwrite(&record, sizeof(record), 1, spillState.file) != 1 ||
+        fwrite(formatted.data(), 1, formatted.size(), spillState.file) != formatted.size()) {
+        perror("Could not write to the spill file");
+        budgetDropped[message.logLevel - 1]++;
+        return;
+    }
+
+    spillState.writeOffset += static_cast<long>(sizeof(record) + formatted.size());
+    spillState.pending++;
+    commitState.enqueued[message.logLevel - 1]++;
+}
+
+bool Logger::write_spilled(std::unique_lock<std::mutex> &lock) {
+    if (spillState.pending == 0) return false;
+
+    spill_record record{nullptr, 0, DEBUG, false, 0};
+    std::string formatted;
+    fseek(spillState.file, spillState.readOffset, SEEK_SET);
+    if (fread(&record, sizeof(record), 1, spillState.file) == 1) {
+        formatted.resize(record.size);
+        if (fread(&formatted[0], 1, record.size, spillState.file) != record.size) {
+            formatted.clear();
+        }
+    }
+
+    spillState.readOffset += static_cast<long>(sizeof(record) + record.size);
+    spillState.pending--;
+    lock.unlock();
+
+    if (!formatted.empty()) {
+        write_formatted(record.logLevel, record._file, record.line, record.to_stderr, formatted);
+    }
+
+    lock.lock();
+    commitState.written[record.logLevel - 1]++;
+    if (spillState.pending == 0) {
+        // Start with an empty file once the memory budget is exhausted again
+        fclose(spillState.file);
+        spillState.file = nullptr;
+    }
+
+    return true;
+}
+
+void Logger::setBudgetPolicy(BudgetPolicy policy, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mtx);
+    budgetPolicy = policy;
+    budgetTimeout = timeout;
+}
+
+LOGGER_MAYBE_UNUSED size_t Logger::getQueuedBytes() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return queuedBytes;
+}
+
+void Logger::setQueueCapacity(LogLevel lvl, size_t capacity) {
+    if (lvl == NONE) return;
+    std::unique_lock<std::mutex> lock(mtx);
+    queueCapacity[lvl - 1] = capacity;
+}
+
+void Logger::setStackTraces(unsigned maxFrames) {
+    stackTraceFrames.store(maxFrames, std::memory_order_relaxed);
+}
+
+void Logger::setDurability(LogLevel lvl, Durability durability) {
+    if (lvl == NONE) return;
+    std::unique_lock<std::mutex> lock(mtx);
+    commitState.durability[lvl - 1].store(durability, std::memory_order_relaxed);
+}
+
+void Logger::flush(bool sync) {
+    if (this->sync != ASYNC) {
+        if (sync) {
+            sync_written(writtenSequence);
+        } else {
+            std::unique_lock<std::mutex> lock(mtx);
+            commit(DURABILITY_FLUSH);
+        }
+
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    uint64_t target[3];
+    std::copy(std::begin(commitState.enqueued), std::end(commitState.enqueued), target);
+    // Only a commit started after this point includes the messages written so far
+    const uint64_t started = commitState.started;
+    commitState.requested = std::max(commitState.requested, started + 1);
+    unsigned &requests = sync ? commitState.syncRequests : commitState.flushRequests;
+    requests++;
+    lock.unlock();
+
+    if (!scheduled.exchange(true)) {
+        executor->schedule(this);
+    }
+
+    lock.lock();
+    queueCondition.wait(lock, [this, &target, started] {
+        return commitState.finished > started && commitState.committed[0] >= target[0] &&
+               commitState.committed[1] >= target[1] && commitState.committed[2] >= target[2];
+    });
+    requests--;
+}
+
+void Logger::setTraceOutput(const char *fileName, TraceFormat format) {
+    LoggerUtils::TraceClock::calibrate();
+
+    FILE *out = fopen(fileName, format == TRACE_BINARY ? "wb" : "w");
+    if (out == nullptr) {
+        std::cerr << "Could not open " << fileName << " file!" << std::endl;
+        return;
+    }
+
+    if (format == TRACE_BINARY) {
+        fwrite("LOGTRC1", 1, 8, out);
+    } else {
+        fputs("[", out);
+    }
+
+    std::unique_lock<std::mutex> lock(traceMtx);
+    if (traceFile != nullptr) {
+        fclose(traceFile);
+    }
+
+    traceFormat = format;
+    firstTraceEvent = true;
+    traceFile = out;
+    tracing.store(true, std::memory_order_release);
+}
+
+LoggerUtils::TraceSpan Logger::_traceSpan(const char *_file, int line, const char *, const char *name) {
+    // Spans are only written while holding traceMtx, starting one does not need it
+    const bool enabled = tracing.load(std::memory_order_acquire) && _mode != MODE_NONE;
+    return LoggerUtils::TraceSpan(enabled ? this : nullptr, name, _file, line);
+}
+
+void Logger::write_span(const trace_span &span) {
+    if (sync == ASYNC) {
+        // Spans are charged against the memory budget like messages, but
+        // never block the thread ending the span: they are dropped instead
+        const bool reserved = LogMemoryBudget::try_reserve(sizeof(trace_span));
+
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!reserved) {
+            droppedSpans++;
+            return;
+        }
+
+        spanQueue.push_back(span);
+        queuedBytes += sizeof(trace_span);
+        lock.unlock();
+
+        if (!scheduled.exchange(true)) {
+            executor->schedule(this);
+        }
+    } else {
+        write_span_impl(span);
+    }
+}
+
+void Logger::write_span_impl(const trace_span &span) {
+    std::unique_lock<std::mutex> lock(traceMtx);
+    if (traceFile == nullptr) return;
+
+    const double start = LoggerUtils::TraceClock::toMicroseconds(span.start);
+    const double duration = LoggerUtils::TraceClock::toMicroseconds(span.end) - start;
+
+    if (traceFormat == TRACE_BINARY) {
+        // Start and duration in nanoseconds, the thread id, the line,
+        // the lengths of the name and the file name followed by both names
+        const uint64_t times[2] = {static_cast<uint64_t>(start * 1000.0), static_cast<uint64_t>(duration * 1000.0)};
+        const uint32_t name_length = static_cast<uint32_t>(strlen(span.name));
+        const uint32_t file_length = static_cast<uint32_t>(strlen(span._file));
+        const uint32_t info[4] = {span.threadId, static_cast<uint32_t>(span.line), name_length, file_length};
+
+        fwrite(times, sizeof(times), 1, traceFile);
+        fwrite(info, sizeof(info), 1, traceFile);
+        fwrite(span.name, 1, name_length, traceFile);
+        fwrite(span._file, 1, file_length, traceFile);
+    } else {
+        std::string event(firstTraceEvent ? "\n" : ",\n");
+        event.append(R"({"name":")");
+        LoggerUtils::appendJsonEscaped(event, span.name);
+        event.append(R"(","cat":")");
+        LoggerUtils::appendJsonEscaped(event, span._file);
+        event.push_back(':');
+        LoggerUtils::appendNumber(event, span.line);
+        event.append(R"(","ph":"X","pid":)");
+        LoggerUtils::appendNumber(event, LoggerUtils::processId());
+        event.append(R"(,"tid":)");
+        LoggerUtils::appendNumber(event, span.threadId);
+
+        char buf[64];
+        event.append(R"(,"ts":)");
+        event.append(buf, snprintf(buf, sizeof(buf), "%.3f", start));
+        event.append(R"(,"dur":)");
+        event.append(buf, snprintf(buf, sizeof(buf), "%.3f", duration));
+        event.push_back('}');
+
+        fwrite(event.data(), 1, event.size(), traceFile);
+        firstTraceEvent = false;
+    }
+}
+
+void Logger::flush_sinks() {
+    const auto current = std::atomic_load(&sinks);
+    for (const auto &sink : *current) {
+        sink->flush();
+    }
+}
+
+void Logger::commit(Durability durability) {
+    if (file != nullptr) {
+        fflush(file);
+        if (durability == DURABILITY_SYNC) {
+#ifdef LOGGER_WINDOWS
+            _commit(_fileno(file));
+#else
+            fdatasync(fileno(file));
+#endif
+        }
+    }
+
+    const auto current = std::atomic_load(&sinks);
+    for (const auto &sink : *current) {
+        if (durability == DURABILITY_SYNC) {
+            sink->sync();
+        } else {
+            sink->flush();
+        }
+    }
+}
+
+void Logger::sync_written(uint64_t sequence) {
+    std::unique_lock<std::mutex> lock(syncMtx);
+    while (syncedSequence < sequence) {
+        if (syncing) {
+            // Another thread is syncing, the next sync will include this thread's message
+            syncCondition.wait(lock);
+            continue;
+        }
+
+        syncing = true;
+        const uint64_t written = writtenSequence;
+        lock.unlock();
+
+        commit(DURABILITY_SYNC);
+        lock.lock();
+        syncing = false;
+        syncedSequence = written;
+        syncCondition.notify_all();
+    }
+}
+
+void Logger::addSink(std::shared_ptr<LogSink> sink) {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto updated = std::make_shared<std::vector<std::shared_ptr<LogSink>>>(*sinks);
+    updated->push_back(std::move(sink));
+    std::atomic_store(&sinks, std::shared_ptr<const std::vector<std::shared_ptr<LogSink>>>(std::move(updated)));
 }
 
 Logger::~Logger() {
+    if (coalesce) {
+        std::unique_lock<std::mutex> lock(repeatMtx);
+        std::vector<log_message> pending = take_repeated_summary();
+        repeatState.count = -1;
+        coalesce = false;
+        lock.unlock();
+
+        dispatch_log_messages(std::move(pending));
+    }
+
     this->debug("Closing logger");
 
     if (sync == ASYNC) {
-        auto future = std::async(std::launch::async, &std::thread::join, &writeThread);
-        run = false;
-        if (future.wait_for(std::chrono::seconds(5)) == std::future_status::timeout) {
-            std::cerr << "Could not stop the write thread in time, just detaching it" << std::endl;
-            writeThread.detach();
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!queueCondition.wait_for(lock, std::chrono::seconds(5), [this] {
+            return queues_empty() && spanQueue.empty() && !scheduled;
+        })) {
+            std::cerr << "Could not write all queued messages in time, writing them on this thread" << std::endl;
+        }
+        lock.unlock();
+
+        executor->remove(this);
+        // Nothing else will drain the queues anymore, write all remaining messages on this thread
+        while (drain(std::numeric_limits<size_t>::max())) {}
+        sync = SYNC;
+
+        if (spillState.file != nullptr) {
+            fclose(spillState.file);
         }
     }
 
+    if (traceFile != nullptr) {
+        if (traceFormat == TRACE_JSON) {
+            fputs("\n]\n", traceFile);
+        }
+
+        fclose(traceFile);
+    }
+
     if (file && (_mode == MODE_BOTH || _mode == MODE_FILE)) {
         this->debug("Closing logger file stream");
 
@@ -246,19 +1069,20 @@ Logger::~Logger() {
 }
 
 void Logger::init(const char *fileName, const char *fileMode) {
-    if (_mode == MODE_BOTH || _mode == MODE_FILE) {
+    // An empty file name only writes to the attached sinks
+    if ((_mode == MODE_BOTH || _mode == MODE_FILE) && fileName != nullptr && fileName[0] != '\0') {
 #ifdef LOGGER_WINDOWS
         errno_t err = fopen_s(&file, fileName, fileMode);
 
         if (err) {
-            perror("Could not open out.log file!");
+            perror("Could not open the log file!");
             file = nullptr;
         }
 #else
-        file = fopen("out.log", fileMode);
-                if (file == nullptr) {
-                    std::cerr << "Could not open out.log file!" << std::endl;
-                }
+        file = fopen(fileName, fileMode);
+        if (file == nullptr) {
+            std::cerr << "Could not open " << fileName << " file!" << std::endl;
+        }
 #endif
     }
 }
@@ -274,6 +1098,7 @@ StaticLogger::create(LoggerMode mode, LogLevel lvl, SyncMode syncMode, const cha
     instance = std::make_unique<Logger>(mode, lvl, syncMode, fileName, fileMode);
 }
 
+#ifndef LOGGER_INLINE_FAST_PATH
 void StaticLogger::_debug(const char *_file, int line, const char *method, const std::string &message) {
     instance->_debug(_file, line, method, message);
 }
@@ -282,13 +1107,28 @@ void StaticLogger::_error(const char *_file, int line, const char *method, const
     instance->_error(_file, line, method, message);
 }
 
+void StaticLogger::_warning(const char *_file, int line, const char *method, const std::string &message) {
+    instance->_warning(_file, line, method, message);
+}
+#endif //LOGGER_INLINE_FAST_PATH
+
+// Captures the stack trace like Logger::_error, so the frame of this wrapper is skipped as well
 void StaticLogger::_error(const char *_file, int line, const char *method, const std::string &message,
                           const std::exception &e) {
-    instance->_error(_file, line, method, message, e);
+    if (ERROR > instance->level) return;
+
+    const unsigned frames = instance->stackTraceFrames.load(std::memory_order_relaxed);
+    instance->write_error(_file, line, method, message, e, nullptr,
+                          frames > 0 ? LoggerUtils::captureStackTrace(frames, 1) : std::vector<void *>());
 }
 
-void StaticLogger::_warning(const char *_file, int line, const char *method, const std::string &message) {
-    instance->_warning(_file, line, method, message);
+void StaticLogger::_error(const LogCategory &category, const char *_file, int line, const char *method,
+                          const std::string &message, const std::exception &e) {
+    if (!category.isEnabled(ERROR, instance->level)) return;
+
+    const unsigned frames = instance->stackTraceFrames.load(std::memory_order_relaxed);
+    instance->write_error(_file, line, method, message, e, category.getName().c_str(),
+                          frames > 0 ? LoggerUtils::captureStackTrace(frames, 1) : std::vector<void *>());
 }
 
 LoggerUtils::LoggerStream StaticLogger::_debugStream(const char *_file, int line, const char *method) {
@@ -303,6 +1143,14 @@ LoggerUtils::LoggerStream StaticLogger::_errorStream(const char *_file, int line
     return instance->_errorStream(_file, line, method);
 }
 
+LoggerUtils::TraceSpan StaticLogger::_traceSpan(const char *_file, int line, const char *method, const char *name) {
+    return instance->_traceSpan(_file, line, method, name);
+}
+
+LOGGER_MAYBE_UNUSED void StaticLogger::setStackTraces(unsigned maxFrames) {
+    instance->setStackTraces(maxFrames);
+}
+
 LOGGER_MAYBE_UNUSED void StaticLogger::reset() {
     instance.reset();
 }
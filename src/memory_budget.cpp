@@ -0,0 +1,73 @@
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+void LogMemoryBudget::setLimit(size_t bytes) {
+    limit = bytes;
+
+    // Waiting threads may fit into the new limit
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.notify_all();
+}
+
+LOGGER_MAYBE_UNUSED size_t LogMemoryBudget::getLimit() {
+    return limit;
+}
+
+size_t LogMemoryBudget::getUsage() {
+    return usage;
+}
+
+bool LogMemoryBudget::try_reserve(size_t bytes) {
+    const size_t max = limit.load(std::memory_order_relaxed);
+    if (max == 0) {
+        usage.fetch_add(bytes, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t current = usage.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > max) {
+            return false;
+        }
+    } while (!usage.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+
+    return true;
+}
+
+bool LogMemoryBudget::reserve(size_t bytes, std::chrono::milliseconds timeout) {
+    if (try_reserve(bytes)) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    waiting++;
+    const bool reserved = cv.wait_for(lock, timeout, [bytes] {
+        return try_reserve(bytes);
+    });
+    waiting--;
+
+    return reserved;
+}
+
+void LogMemoryBudget::release(size_t bytes) {
+    usage.fetch_sub(bytes, std::memory_order_relaxed);
+
+    // Only take the lock if any thread is waiting for memory
+    if (waiting.load() > 0) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.notify_all();
+    }
+}
+
+std::atomic<size_t> LogMemoryBudget::limit(0);
+
+std::atomic<size_t> LogMemoryBudget::usage(0);
+
+std::atomic<unsigned> LogMemoryBudget::waiting(0);
+
+std::mutex LogMemoryBudget::mtx;
+
+std::condition_variable LogMemoryBudget::cv;
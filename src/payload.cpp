@@ -0,0 +1,98 @@
+#include <array>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    constexpr char hex_digits[] = "0123456789abcdef";
+    constexpr char base64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    /**
+     * The two hex digits of every byte value
+     */
+    constexpr std::array<char, 512> make_hex_table() {
+        std::array<char, 512> table{};
+        for (size_t i = 0; i < 256; i++) {
+            table[i * 2] = hex_digits[i >> 4];
+            table[i * 2 + 1] = hex_digits[i & 0xf];
+        }
+
+        return table;
+    }
+
+    constexpr std::array<char, 512> hex_table = make_hex_table();
+
+    // The width of one hex dump line: 4 spaces, 8 offset digits, 2 spaces, 16 bytes
+    // in hex followed by a space each, an extra space after 8 bytes, a space, |16 chars| and a new line
+    constexpr size_t hex_line_size = 4 + 8 + 2 + 16 * 3 + 1 + 1 + 18 + 1;
+}
+
+void LoggerUtils::appendHexDump(std::string &out, const void *data, size_t size, size_t offset) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    const size_t start = out.size();
+    const size_t lines = (size + 15) / 16;
+
+    // Every line is rendered into the string directly, without any intermediate buffers
+    out.resize(start + lines * hex_line_size, ' ');
+    char *line = &out[start];
+
+    for (size_t i = 0; i < size; i += 16, line += hex_line_size) {
+        const size_t count = std::min<size_t>(16, size - i);
+        const size_t position = offset + i;
+
+        char *p = line + 4;
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            *p++ = hex_digits[(position >> shift) & 0xf];
+        }
+
+        p += 2;
+        for (size_t j = 0; j < count; j++) {
+            memcpy(p, &hex_table[bytes[i + j] * 2], 2);
+            p += j == 7 ? 4 : 3;
+        }
+
+        p = line + 4 + 8 + 2 + 16 * 3 + 1 + 1;
+        *p++ = '|';
+        for (size_t j = 0; j < count; j++) {
+            const unsigned char c = bytes[i + j];
+            *p++ = c >= 0x20 && c < 0x7f ? static_cast<char>(c) : '.';
+        }
+
+        *p++ = '|';
+        // Shorten the last line if it has less than 16 bytes
+        if (count < 16) {
+            *p++ = '\n';
+            out.resize(static_cast<size_t>(p - out.data()));
+            break;
+        }
+
+        *p = '\n';
+    }
+}
+
+void LoggerUtils::appendBase64(std::string &out, const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    const size_t start = out.size();
+    out.resize(start + (size + 2) / 3 * 4);
+    char *p = &out[start];
+
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {
+        const uint32_t value = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+        *p++ = base64_digits[(value >> 18) & 0x3f];
+        *p++ = base64_digits[(value >> 12) & 0x3f];
+        *p++ = base64_digits[(value >> 6) & 0x3f];
+        *p++ = base64_digits[value & 0x3f];
+    }
+
+    if (i < size) {
+        const uint32_t value = (bytes[i] << 16) | (i + 1 < size ? bytes[i + 1] << 8 : 0);
+        *p++ = base64_digits[(value >> 18) & 0x3f];
+        *p++ = base64_digits[(value >> 12) & 0x3f];
+        *p++ = i + 1 < size ? base64_digits[(value >> 6) & 0x3f] : '=';
+        *p = '=';
+    }
+}
@@ -0,0 +1,365 @@
+#include <iostream>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    constexpr uint64_t ring_magic = 0x314752474f4c; // "LOGRG1"
+    // The number of segment names tried before giving up
+    constexpr int max_segment_attempts = 1000;
+    constexpr uint32_t padding_record = 0xffffffff;
+
+    /**
+     * The header at the start of each shared memory segment.
+     * head is only written by the producer, tail only by the collector,
+     * both are byte positions which are never wrapped.
+     */
+    struct ring_header {
+        std::atomic<uint64_t> magic;
+        uint64_t capacity;
+        int32_t pid;
+        std::atomic<uint32_t> closed;
+        std::atomic<uint64_t> dropped;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+    };
+
+    struct record_header {
+        uint32_t size;
+        uint32_t reserved;
+        uint64_t timestamp;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring requires lock-free 64 bit atomics");
+
+    constexpr size_t data_offset = (sizeof(ring_header) + 63) / 64 * 64;
+
+    size_t align8(size_t value) {
+        return (value + 7) & ~static_cast<size_t>(7);
+    }
+
+    ring_header *header(void *segment) {
+        return static_cast<ring_header *>(segment);
+    }
+
+    char *ring_data(void *segment) {
+        return static_cast<char *>(segment) + data_offset;
+    }
+
+    bool process_alive(int32_t pid) {
+        return kill(pid, 0) == 0 || errno != ESRCH;
+    }
+
+    /**
+     * Remove a segment, unless its name has been taken by a new segment in the meantime
+     */
+    void unlink_segment(const std::string &segmentName, unsigned long long inode) {
+        struct stat st{};
+        if (stat(("/dev/shm" + segmentName).c_str(), &st) == 0 && static_cast<unsigned long long>(st.st_ino) == inode) {
+            shm_unlink(segmentName.c_str());
+        }
+    }
+
+    /**
+     * Check if a segment file name is "<pid>.<n>" after the prefix
+     */
+    bool is_segment_suffix(const std::string &fileName, size_t start) {
+        const size_t dot = fileName.find('.', start);
+        return dot != std::string::npos && dot > start && dot + 1 < fileName.size() &&
+               fileName.find_first_not_of("0123456789", start) == dot &&
+               fileName.find_first_not_of("0123456789", dot + 1) == std::string::npos;
+    }
+}
+
+// SharedMemorySink class ==========================================
+
+SharedMemorySink::SharedMemorySink(const std::string &name, size_t capacity) : segmentName(), segment(nullptr),
+                                                                               segmentSize(0), mtx() {
+    size_t ringSize = 4096;
+    while (ringSize < capacity) ringSize <<= 1;
+
+    // Every sink of a process gets its own segment. A segment left behind by a crashed
+    // process with the same pid may still hold messages, so it is skipped, not replaced.
+    static std::atomic<unsigned> nextInstance(0);
+    int fd = -1;
+    for (int attempt = 0; attempt < max_segment_attempts && fd < 0; attempt++) {
+        segmentName = "/" + name + "." + std::to_string(getpid()) + "." +
+                      std::to_string(nextInstance.fetch_add(1, std::memory_order_relaxed));
+        fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno != EEXIST) break;
+    }
+
+    if (fd < 0) {
+        perror("Could not create the shared memory segment");
+        return;
+    }
+
+    segmentSize = data_offset + ringSize;
+    if (ftruncate(fd, static_cast<off_t>(segmentSize)) != 0) {
+        perror("Could not resize the shared memory segment");
+        close(fd);
+        shm_unlink(segmentName.c_str());
+        return;
+    }
+
+    void *ptr = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        perror("Could not map the shared memory segment");
+        shm_unlink(segmentName.c_str());
+        return;
+    }
+
+    segment = ptr;
+    ring_header *h = new(segment) ring_header();
+    h->capacity = ringSize;
+    h->pid = static_cast<int32_t>(getpid());
+    // The collector ignores the segment until the magic is set
+    h->magic.store(ring_magic, std::memory_order_release);
+}
+
+void SharedMemorySink::write(LogLevel, const char *, int, const std::string &message) {
+    if (segment == nullptr) return;
+
+    ring_header *h = header(segment);
+    const uint64_t capacity = h->capacity;
+    const size_t needed = align8(sizeof(record_header) + message.size());
+    const uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    uint64_t head = h->head.load(std::memory_order_relaxed);
+    const uint64_t tail = h->tail.load(std::memory_order_acquire);
+
+    size_t pos = head & (capacity - 1);
+    const size_t contiguous = capacity - pos;
+    const size_t total = contiguous < needed ? contiguous + needed : needed;
+    if (needed > capacity / 2 || capacity - (head - tail) < total) {
+        h->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    char *data = ring_data(segment);
+    if (contiguous < needed) {
+        // Records never wrap around, skip the rest of the ring
+        const uint32_t padding = padding_record;
+        memcpy(data + pos, &padding, sizeof(padding));
+        head += contiguous;
+        pos = 0;
+    }
+
+    record_header record{static_cast<uint32_t>(message.size()), 0, timestamp};
+    memcpy(data + pos, &record, sizeof(record));
+    memcpy(data + pos + sizeof(record), message.data(), message.size());
+    h->head.store(head + needed, std::memory_order_release);
+}
+
+size_t SharedMemorySink::droppedMessages() const {
+    if (segment == nullptr) return 0;
+    return header(segment)->dropped.load(std::memory_order_relaxed);
+}
+
+SharedMemorySink::~SharedMemorySink() {
+    if (segment != nullptr) {
+        ring_header *h = header(segment);
+        h->closed.store(1, std::memory_order_release);
+
+        // Nothing is left to collect, so don't leave the segment behind if no collector is running.
+        // A segment with messages is kept until a collector has drained it.
+        if (h->head.load(std::memory_order_relaxed) == h->tail.load(std::memory_order_acquire)) {
+            shm_unlink(segmentName.c_str());
+        }
+
+        munmap(segment, segmentSize);
+    }
+}
+
+// SharedMemoryCollector class ==========================================
+
+SharedMemoryCollector::SharedMemoryCollector(std::string name) : name(std::move(name)), rings() {}
+
+void SharedMemoryCollector::attach_new_rings() {
+    DIR *dir = opendir("/dev/shm");
+    if (dir == nullptr) return;
+
+    const std::string prefix = name + ".";
+    while (dirent *entry = readdir(dir)) {
+        const std::string fileName(entry->d_name);
+        if (fileName.compare(0, prefix.size(), prefix) != 0 || !is_segment_suffix(fileName, prefix.size())) {
+            continue;
+        }
+
+        const std::string segmentName = "/" + fileName;
+        const auto inode = static_cast<unsigned long long>(entry->d_ino);
+        if (std::any_of(rings.begin(), rings.end(), [&segmentName, inode](const ring &r) {
+            return r.segmentName == segmentName && r.inode == inode;
+        })) {
+            continue;
+        }
+
+        int fd = shm_open(segmentName.c_str(), O_RDWR, 0);
+        if (fd < 0) continue;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= data_offset) {
+            close(fd);
+            continue;
+        }
+
+        const auto size = static_cast<size_t>(st.st_size);
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) continue;
+
+        // Ignore segments which are not initialized yet or do not match their size.
+        // The capacity is used as a mask, so it must be a power of two.
+        ring_header *h = header(ptr);
+        const bool initialized = h->magic.load(std::memory_order_acquire) == ring_magic;
+        const uint64_t capacity = h->capacity;
+        if (!initialized || capacity == 0 || (capacity & (capacity - 1)) != 0 || data_offset + capacity != size) {
+            munmap(ptr, size);
+            continue;
+        }
+
+        // An empty segment removed by its sink may have its name reused by a new process
+        // with the same pid, the old segment is only drained and unmapped, but not unlinked
+        for (auto &r : rings) {
+            if (r.segmentName == segmentName) {
+                r.orphaned = true;
+            }
+        }
+
+        rings.push_back({segmentName, ptr, size, capacity, inode, 0, false});
+    }
+
+    closedir(dir);
+}
+
+size_t SharedMemoryCollector::poll(FILE *out) {
+    attach_new_rings();
+
+    struct cursor {
+        ring *r;
+        uint64_t position;
+        uint64_t head;
+        const record_header *next;
+    };
+
+    // Find the next record of a ring, skipping the padding at the end of the ring
+    const auto advance = [](cursor &c) {
+        // Never read the capacity from the ring again, it may have been overwritten
+        const uint64_t capacity = c.r->capacity;
+        c.next = nullptr;
+
+        while (c.position < c.head) {
+            const size_t pos = c.position & (capacity - 1);
+            const char *data = ring_data(c.r->segment) + pos;
+
+            uint32_t size;
+            memcpy(&size, data, sizeof(size));
+            if (size == padding_record) {
+                c.position += capacity - pos;
+                continue;
+            }
+
+            // Never trust the contents of the ring, the producer may have been killed at any time
+            if (capacity - pos < sizeof(record_header) ||
+                align8(sizeof(record_header) + size) > std::min<uint64_t>(capacity - pos, c.head - c.position)) {
+                c.position = c.head;
+                break;
+            }
+
+            c.next = reinterpret_cast<const record_header *>(data);
+            break;
+        }
+    };
+
+    std::vector<cursor> cursors;
+    cursors.reserve(rings.size());
+    for (auto &r : rings) {
+        ring_header *h = header(r.segment);
+        cursor c{&r, h->tail.load(std::memory_order_relaxed), h->head.load(std::memory_order_acquire), nullptr};
+        advance(c);
+        cursors.push_back(c);
+    }
+
+    size_t written = 0;
+    while (true) {
+        cursor *oldest = nullptr;
+        for (auto &c : cursors) {
+            if (c.next != nullptr && (oldest == nullptr || c.next->timestamp < oldest->next->timestamp)) {
+                oldest = &c;
+            }
+        }
+
+        if (oldest == nullptr) break;
+
+        fwrite(reinterpret_cast<const char *>(oldest->next) + sizeof(record_header), 1, oldest->next->size, out);
+        oldest->position += align8(sizeof(record_header) + oldest->next->size);
+        written++;
+        advance(*oldest);
+    }
+
+    for (auto &c : cursors) {
+        ring_header *h = header(c.r->segment);
+        h->tail.store(c.position, std::memory_order_release);
+
+        const uint64_t dropped = h->dropped.load(std::memory_order_relaxed);
+        if (dropped != c.r->reportedDrops) {
+            fprintf(out, "Process %d dropped %llu messages because the shared memory ring was full\n", h->pid,
+                    static_cast<unsigned long long>(dropped - c.r->reportedDrops));
+            c.r->reportedDrops = dropped;
+        }
+    }
+
+    // Remove the rings of all processes which have exited and whose rings are empty
+    rings.erase(std::remove_if(rings.begin(), rings.end(), [](const ring &r) {
+        ring_header *h = header(r.segment);
+        const bool finished = r.orphaned || h->closed.load(std::memory_order_acquire) != 0 ||
+                              !process_alive(h->pid);
+        if (finished && h->head.load(std::memory_order_acquire) == h->tail.load(std::memory_order_relaxed)) {
+            if (!r.orphaned) {
+                unlink_segment(r.segmentName, r.inode);
+            }
+
+            munmap(r.segment, r.segmentSize);
+            return true;
+        }
+
+        return false;
+    }), rings.end());
+
+    return written;
+}
+
+void SharedMemoryCollector::run(FILE *out, const std::atomic<bool> &running, std::chrono::milliseconds interval) {
+    while (running) {
+        if (poll(out) > 0) {
+            fflush(out);
+        } else {
+            std::this_thread::sleep_for(interval);
+        }
+    }
+
+    poll(out);
+    fflush(out);
+}
+
+SharedMemoryCollector::~SharedMemoryCollector() {
+    for (const auto &r : rings) {
+        munmap(r.segment, r.segmentSize);
+    }
+}
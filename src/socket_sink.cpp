@@ -0,0 +1,279 @@
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+#ifdef MSG_NOSIGNAL
+    constexpr int send_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+    constexpr int send_flags = MSG_DONTWAIT;
+#endif
+
+#ifdef __linux__
+    // The maximum number of datagrams sent using a single sendmmsg call
+    constexpr unsigned max_datagrams = 64;
+#endif
+
+    /**
+     * Get the syslog severity of a log level
+     */
+    int syslog_severity(LogLevel level) {
+        switch (level) {
+            case ERROR:
+                return 3;
+            case WARNING:
+                return 4;
+            default:
+                return 7;
+        }
+    }
+
+    /**
+     * Append the current time as a RFC 3339 timestamp in UTC
+     */
+    void append_timestamp(std::string &out) {
+        const auto now = std::chrono::system_clock::now();
+        const time_t seconds = std::chrono::system_clock::to_time_t(now);
+        const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                now.time_since_epoch()).count() % 1000000;
+
+        struct tm time{};
+        gmtime_r(&seconds, &time);
+
+        char buf[64];
+        const size_t size = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &time);
+        out.append(buf, size);
+        out.append(buf, snprintf(buf, sizeof(buf), ".%06dZ", static_cast<int>(micros)));
+    }
+
+    /**
+     * Check if a send error means the agent will not accept anything
+     * on this socket, so it must be closed and connected again
+     */
+    bool is_disconnect(int error) {
+        return error != EAGAIN && error != EWOULDBLOCK && error != ENOBUFS && error != EINTR &&
+               error != EMSGSIZE;
+    }
+}
+
+SocketSink::SocketSink(std::string path, SocketSinkOptions options) : path(std::move(path)),
+                                                                     options(std::move(options)), hostName("-"),
+                                                                     processId(std::to_string(getpid())), fd(-1),
+                                                                     nextConnect(), buffer(), records(),
+                                                                     firstRecord(0), sent(0), dropped(0), mtx() {
+    char name[256];
+    if (gethostname(name, sizeof(name)) == 0) {
+        name[sizeof(name) - 1] = '\0';
+        hostName = name;
+    }
+
+    if (this->options.appName.empty()) {
+        this->options.appName = "-";
+    }
+
+    connect_socket();
+}
+
+void SocketSink::write(LogLevel level, const char *, int, const std::string &message) {
+    size_t size = message.size();
+    // Datagrams and syslog records carry their own boundaries
+    if ((options.syslog || options.type == SOCKET_DATAGRAM) && size > 0 && message[size - 1] == '\n') {
+        size--;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    const size_t start = buffer.size();
+    if (options.syslog) {
+        std::string header;
+        header.push_back('<');
+        header.append(std::to_string(options.facility * 8 + syslog_severity(level)));
+        header.append(">1 ");
+        append_timestamp(header);
+        header.append(" ").append(hostName);
+        header.append(" ").append(options.appName);
+        header.append(" ").append(processId);
+        header.append(" - - ");
+
+        if (options.type == SOCKET_STREAM) {
+            buffer.append(std::to_string(header.size() + size)).push_back(' ');
+        }
+
+        buffer.append(header);
+    }
+
+    buffer.append(message, 0, size);
+    if (buffer.size() - sent > options.maxBuffered) {
+        // The agent is too slow or absent, never let the buffer grow any further
+        buffer.resize(start);
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    records.push_back(buffer.size());
+    if (buffer.size() - sent >= options.batchSize) {
+        send_buffered();
+    }
+}
+
+void SocketSink::flush() {
+    std::unique_lock<std::mutex> lock(mtx);
+    send_buffered();
+}
+
+size_t SocketSink::droppedMessages() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+SocketSink::~SocketSink() {
+    send_buffered();
+    disconnect();
+}
+
+bool SocketSink::connect_socket() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now < nextConnect) return false;
+    nextConnect = now + options.reconnectInterval;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    fd = socket(AF_UNIX, options.type == SOCKET_STREAM ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+
+    // The socket is non-blocking before connecting, so connecting
+    // to an agent with a full backlog fails instead of waiting
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        disconnect();
+        return false;
+    }
+
+    return true;
+}
+
+void SocketSink::disconnect() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void SocketSink::send_buffered() {
+    if (firstRecord < records.size() && (fd >= 0 || connect_socket())) {
+        if (options.type == SOCKET_STREAM) {
+            send_stream();
+        } else {
+            send_datagrams();
+        }
+    }
+
+    if (firstRecord == records.size()) {
+        buffer.clear();
+        records.clear();
+        firstRecord = 0;
+        sent = 0;
+    } else if (sent > buffer.size() / 2) {
+        // Move the rest of the buffer to the front once most of it has been sent
+        const size_t consumed = firstRecord == 0 ? 0 : records[firstRecord - 1];
+        buffer.erase(0, consumed);
+        records.erase(records.begin(), records.begin() + static_cast<long>(firstRecord));
+        for (auto &end : records) {
+            end -= consumed;
+        }
+
+        sent -= consumed;
+        firstRecord = 0;
+    }
+}
+
+void SocketSink::send_datagrams() {
+    while (firstRecord < records.size()) {
+#ifdef __linux__
+        mmsghdr messages[max_datagrams];
+        iovec vectors[max_datagrams];
+        unsigned count = 0;
+        for (size_t i = firstRecord; i < records.size() && count < max_datagrams; i++, count++) {
+            const size_t start = i == 0 ? 0 : records[i - 1];
+            vectors[count].iov_base = &buffer[start];
+            vectors[count].iov_len = records[i] - start;
+            messages[count] = mmsghdr{};
+            messages[count].msg_hdr.msg_iov = &vectors[count];
+            messages[count].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int result = sendmmsg(fd, messages, count, send_flags);
+        if (result > 0) {
+            firstRecord += result;
+            sent = records[firstRecord - 1];
+            continue;
+        }
+#else
+        const size_t start = firstRecord == 0 ? 0 : records[firstRecord - 1];
+        const ssize_t result = send(fd, &buffer[start], records[firstRecord] - start, send_flags);
+        if (result >= 0) {
+            sent = records[firstRecord++];
+            continue;
+        }
+#endif
+
+        if (errno == EINTR) continue;
+        if (errno == EMSGSIZE) {
+            // The agent will never accept this datagram
+            drop_record();
+            continue;
+        }
+
+        if (is_disconnect(errno)) {
+            disconnect();
+        }
+
+        return;
+    }
+}
+
+void SocketSink::send_stream() {
+    while (sent < buffer.size()) {
+        const ssize_t result = send(fd, &buffer[sent], buffer.size() - sent, send_flags);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            if (is_disconnect(errno)) {
+                disconnect();
+                // The new connection must start at a record boundary
+                const size_t start = firstRecord == 0 ? 0 : records[firstRecord - 1];
+                if (sent != start) {
+                    drop_record();
+                }
+            }
+
+            return;
+        }
+
+        sent += static_cast<size_t>(result);
+        while (firstRecord < records.size() && records[firstRecord] <= sent) {
+            firstRecord++;
+        }
+    }
+}
+
+void SocketSink::drop_record() {
+    sent = records[firstRecord++];
+    dropped.fetch_add(1, std::memory_order_relaxed);
+}
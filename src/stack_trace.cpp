@@ -0,0 +1,87 @@
+#include <mutex>
+#include <unordered_map>
+#include <cstdlib>
+
+#ifndef _WIN32
+#   include <dlfcn.h>
+#   include <execinfo.h>
+#   include <cxxabi.h>
+#endif
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+#ifndef _WIN32
+    /**
+     * Resolve the function and module of a return address
+     */
+    std::string resolve_frame(void *address) {
+        char buf[32];
+        std::string frame(buf, snprintf(buf, sizeof(buf), "%p", address));
+
+        Dl_info info{};
+        if (dladdr(address, &info) == 0) {
+            return frame;
+        }
+
+        if (info.dli_sname != nullptr) {
+            int status = -1;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            frame.append(" ").append(status == 0 ? demangled : info.dli_sname);
+            free(demangled);
+
+            const auto offset = static_cast<const char *>(address) - static_cast<const char *>(info.dli_saddr);
+            frame.append(buf, snprintf(buf, sizeof(buf), "+0x%tx", offset));
+        }
+
+        if (info.dli_fname != nullptr) {
+            frame.append(" (").append(LoggerUtils::removeSlash(info.dli_fname)).append(")");
+        }
+
+        return frame;
+    }
+#endif
+}
+
+std::vector<void *> LoggerUtils::captureStackTrace(unsigned maxFrames, unsigned skip) {
+#ifndef _WIN32
+    // Skip this function as well
+    skip++;
+
+    std::vector<void *> frames(maxFrames + skip);
+    const int captured = backtrace(frames.data(), static_cast<int>(frames.size()));
+    if (captured <= static_cast<int>(skip)) {
+        return {};
+    }
+
+    frames.resize(captured);
+    frames.erase(frames.begin(), frames.begin() + skip);
+    return frames;
+#else
+    return {};
+#endif
+}
+
+void LoggerUtils::appendStackTrace(std::string &out, const std::vector<void *> &frames) {
+#ifndef _WIN32
+    // Never freed, the cache may still be used by loggers destroyed during static destruction
+    static auto *mtx = new std::mutex();
+    static auto *cache = new std::unordered_map<void *, std::string>();
+
+    std::unique_lock<std::mutex> lock(*mtx);
+    for (size_t i = 0; i < frames.size(); i++) {
+        auto it = cache->find(frames[i]);
+        if (it == cache->end()) {
+            it = cache->emplace(frames[i], resolve_frame(frames[i])).first;
+        }
+
+        out.append("\n    #");
+        appendNumber(out, static_cast<long long>(i));
+        out.append(" ").append(it->second);
+    }
+#endif
+}
@@ -0,0 +1,182 @@
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+
+#ifdef __linux__
+#   include <unistd.h>
+#   include <sys/syscall.h>
+#elif defined(_WIN32)
+#   include <process.h>
+#else
+#   include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   else
+#       include <x86intrin.h>
+#       include <cpuid.h>
+#   endif
+#   define LOGGER_TRACE_TSC
+#endif
+
+#define LOGGER_NO_UNDEF
+
+#include "logger.hpp"
+
+using namespace markusjx::logging;
+
+namespace {
+    /**
+     * Check if the CPU has an invariant time stamp counter,
+     * which ticks at a constant rate in all power states
+     */
+    bool has_invariant_tsc() {
+#ifdef LOGGER_TRACE_TSC
+#   ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0x80000000);
+        if (static_cast<unsigned>(regs[0]) < 0x80000007) return false;
+
+        __cpuid(regs, 0x80000007);
+        return (regs[3] & (1 << 8)) != 0;
+#   else
+        unsigned eax, ebx, ecx, edx;
+        if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) return false;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+
+        return (edx & (1 << 8)) != 0;
+#   endif
+#else
+        return false;
+#endif
+    }
+
+    uint64_t steady_now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * The calibration of the trace clock, never changed once calibrated
+     */
+    struct clock_state {
+        bool useTsc = false;
+        double ticksPerMicrosecond = 1000.0;
+        uint64_t base = 0;
+    };
+
+    clock_state calibrate_clock() {
+        clock_state state;
+        if (has_invariant_tsc()) {
+#ifdef LOGGER_TRACE_TSC
+            const auto steadyStart = std::chrono::steady_clock::now();
+            const uint64_t tscStart = __rdtsc();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            const uint64_t tscEnd = __rdtsc();
+            const auto steadyEnd = std::chrono::steady_clock::now();
+
+            const auto elapsed = std::chrono::duration<double, std::micro>(steadyEnd - steadyStart).count();
+            state.ticksPerMicrosecond = static_cast<double>(tscEnd - tscStart) / elapsed;
+            state.base = tscStart;
+            state.useTsc = true;
+            return state;
+#endif
+        }
+
+        state.base = steady_now();
+        return state;
+    }
+
+    /**
+     * Get the calibration, calibrating the clock on the first call.
+     * The initialization of the static is thread safe, so every
+     * thread sees the complete calibration.
+     */
+    const clock_state &calibration() {
+        static const clock_state state = calibrate_clock();
+        return state;
+    }
+}
+
+// LoggerUtils namespace ==========================================
+
+uint32_t LoggerUtils::threadId() {
+#ifdef __linux__
+    static thread_local const auto id = static_cast<uint32_t>(syscall(SYS_gettid));
+#else
+    static std::atomic<uint32_t> next(1);
+    static thread_local const uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+#endif
+    return id;
+}
+
+long long LoggerUtils::processId() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+void LoggerUtils::appendJsonEscaped(std::string &out, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    for (; *str != '\0'; str++) {
+        const auto c = static_cast<unsigned char>(*str);
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x20) {
+            out.append("\\u00");
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+        } else {
+            out.push_back(static_cast<char>(c));
+        }
+    }
+}
+
+// TraceClock class ==========================================
+
+uint64_t LoggerUtils::TraceClock::now() {
+    const clock_state &state = calibration();
+#ifdef LOGGER_TRACE_TSC
+    if (state.useTsc) return __rdtsc();
+#endif
+    return steady_now();
+}
+
+double LoggerUtils::TraceClock::toMicroseconds(uint64_t ticks) {
+    const clock_state &state = calibration();
+    return static_cast<double>(ticks - state.base) / state.ticksPerMicrosecond;
+}
+
+void LoggerUtils::TraceClock::calibrate() {
+    calibration();
+}
+
+// TraceSpan class ==========================================
+
+LoggerUtils::TraceSpan::TraceSpan(Logger *logger, const char *name, const char *_file, int line) : logger(logger),
+                                                                                                  name(name),
+                                                                                                  _file(_file),
+                                                                                                  line(line),
+                                                                                                  start(0) {
+    if (logger != nullptr) {
+        start = TraceClock::now();
+    }
+}
+
+LoggerUtils::TraceSpan::TraceSpan(TraceSpan &&other) noexcept: logger(other.logger), name(other.name),
+                                                                _file(other._file), line(other.line),
+                                                                start(other.start) {
+    other.logger = nullptr;
+}
+
+LoggerUtils::TraceSpan::~TraceSpan() {
+    if (logger == nullptr) return;
+
+    const uint64_t end = TraceClock::now();
+    logger->write_span({name, _file, line, threadId(), start, end});
+}
@@ -1,8 +1,451 @@
 #include <iostream>
 #include <logger.hpp>
 
+#ifndef _WIN32
+#   include <unistd.h>
+#   include <dirent.h>
+#   include <sys/socket.h>
+#   include <sys/un.h>
+#endif
+
 using namespace markusjx::logging;
 
+namespace {
+    /**
+     * A sink keeping all messages written to it
+     */
+    class CapturingSink : public LogSink {
+    public:
+        void write(LogLevel, const char *, int, const std::string &message) override {
+            std::unique_lock<std::mutex> lock(mtx);
+            text.append(message);
+        }
+
+        std::string text;
+        std::mutex mtx;
+    };
+
+    /**
+     * Decode the indented base64 lines of a payload, fails on padding inside the data
+     */
+    bool decodeBase64Lines(const std::string &text, std::string &out) {
+        static const std::string digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string encoded;
+        std::istringstream lines(text);
+        for (std::string line; std::getline(lines, line);) {
+            if (line.compare(0, 4, "    ") == 0) {
+                encoded.append(line, 4, std::string::npos);
+            }
+        }
+
+        if (encoded.size() % 4 != 0) return false;
+        for (size_t i = 0; i < encoded.size(); i += 4) {
+            uint32_t value = 0;
+            int padding = 0;
+            for (size_t j = i; j < i + 4; j++) {
+                if (encoded[j] == '=' && i + 4 == encoded.size()) {
+                    padding++;
+                    value <<= 6;
+                } else {
+                    const size_t digit = digits.find(encoded[j]);
+                    if (digit == std::string::npos || padding > 0) return false;
+                    value = (value << 6) | static_cast<uint32_t>(digit);
+                }
+            }
+
+            out.push_back(static_cast<char>(value >> 16));
+            if (padding < 2) out.push_back(static_cast<char>((value >> 8) & 0xff));
+            if (padding < 1) out.push_back(static_cast<char>(value & 0xff));
+        }
+
+        return true;
+    }
+
+    /**
+     * Print the failed check
+     */
+    bool check(bool condition, const std::string &what) {
+        if (!condition) {
+            std::cerr << "Check failed: " << what << std::endl;
+        }
+
+        return condition;
+    }
+
+    /**
+     * The order in which loggers sharing an executor were written,
+     * with a gate to keep the executor busy
+     */
+    struct ExecutorProbe {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool open = true;
+        int blocked = 0;
+        std::string order;
+
+        void setOpen(bool value) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                open = value;
+            }
+
+            cv.notify_all();
+        }
+
+        void waitBlocked() {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return blocked > 0; });
+        }
+    };
+
+    /**
+     * A sink recording the id of its logger, or '!' if it is written by two threads at once
+     */
+    class ProbeSink : public LogSink {
+    public:
+        ProbeSink(ExecutorProbe &probe, char id) : probe(probe), id(id), writing(false) {}
+
+        void write(LogLevel, const char *, int, const std::string &) override {
+            const bool concurrent = writing.exchange(true);
+            {
+                std::unique_lock<std::mutex> lock(probe.mtx);
+                probe.blocked++;
+                probe.cv.notify_all();
+                probe.cv.wait(lock, [this] { return probe.open; });
+                probe.blocked--;
+                probe.order.push_back(concurrent ? '!' : id);
+            }
+
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            writing = false;
+        }
+
+    private:
+        ExecutorProbe &probe;
+        char id;
+        std::atomic<bool> writing;
+    };
+
+    /**
+     * Share executors between loggers
+     */
+    bool testSharedExecutor() {
+        ExecutorProbe probe;
+        {
+            // A logger is only scheduled once, so two threads never write it at the same time
+            auto executor = std::make_shared<LoggerExecutor>(2);
+            Logger a(MODE_FILE, DEBUG, ASYNC, "", "at", executor), b(MODE_FILE, DEBUG, ASYNC, "", "at", executor);
+            a.addSink(std::make_shared<ProbeSink>(probe, 'a'));
+            b.addSink(std::make_shared<ProbeSink>(probe, 'b'));
+            for (int i = 0; i < 1000; i++) {
+                a.debug("message");
+                b.debug("message");
+            }
+        }
+
+        if (!check(probe.order.find('!') == std::string::npos, "shared executor writes a logger once at a time")) {
+            return false;
+        }
+
+        auto executor = std::make_shared<LoggerExecutor>(1);
+        {
+            // A busy logger does not keep the messages of another logger from being written
+            Logger a(MODE_FILE, DEBUG, ASYNC, "", "at", executor), b(MODE_FILE, DEBUG, ASYNC, "", "at", executor);
+            a.addSink(std::make_shared<ProbeSink>(probe, 'a'));
+            b.addSink(std::make_shared<ProbeSink>(probe, 'b'));
+
+            probe.order.clear();
+            probe.setOpen(false);
+            for (int i = 0; i < 1000; i++) {
+                a.debug("message");
+            }
+
+            for (int i = 0; i < 10; i++) {
+                b.debug("message");
+            }
+
+            probe.setOpen(true);
+            a.flush();
+            b.flush();
+
+            std::unique_lock<std::mutex> lock(probe.mtx);
+            if (!check(probe.order.rfind('b') < probe.order.rfind('a'), "shared executor fairness")) {
+                return false;
+            }
+        }
+
+        // A logger destroyed while the executor is stuck writing it writes the rest itself
+        probe.order.clear();
+        probe.setOpen(false);
+        std::thread opener;
+        {
+            Logger logger(MODE_FILE, DEBUG, ASYNC, "", "at", executor);
+            logger.addSink(std::make_shared<ProbeSink>(probe, 'b'));
+            for (int i = 0; i < 1000; i++) {
+                logger.debug("message");
+            }
+
+            probe.waitBlocked();
+            opener = std::thread([&probe] {
+                std::this_thread::sleep_for(std::chrono::seconds(6));
+                probe.setOpen(true);
+            });
+        }
+
+        opener.join();
+        // All messages and "Closing logger"
+        return check(probe.order == std::string(1001, 'b'), "shared executor remove while busy");
+    }
+
+    /**
+     * Count the occurrences of a text
+     */
+    size_t countOf(const std::string &text, const std::string &needle) {
+        size_t count = 0;
+        for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) {
+            count++;
+        }
+
+        return count;
+    }
+
+    /**
+     * Fill the debug queue of a logger while its executor is busy
+     */
+    bool testQueueCapacity() {
+        ExecutorProbe probe;
+        auto capture = std::make_shared<CapturingSink>();
+        Logger logger(MODE_FILE, DEBUG, ASYNC, "", "at", std::make_shared<LoggerExecutor>(1));
+        logger.addSink(std::make_shared<ProbeSink>(probe, 'a'));
+        logger.addSink(capture);
+        logger.setQueueCapacity(DEBUG, 10);
+
+        probe.setOpen(false);
+        logger.error("Blocking the executor");
+        probe.waitBlocked();
+        for (int i = 0; i < 100; i++) {
+            logger.debugf("queued debug %d", i);
+            if (i % 5 == 0) {
+                logger.errorf("queued error %d", i);
+            }
+        }
+
+        probe.setOpen(true);
+        logger.flush();
+
+        std::unique_lock<std::mutex> lock(capture->mtx);
+        const std::string &text = capture->text;
+        return check(countOf(text, "queued error ") == 20, "errors are kept if the debug queue is full") &&
+               check(countOf(text, "queued debug ") == 10, "debug messages are dropped if the queue is full") &&
+               check(text.find("Dropped 90 DEBUG messages because the queue was full") != std::string::npos,
+                     "dropped debug messages are reported") &&
+               check(text.rfind("queued error ") < text.find("queued debug "), "errors are written first");
+    }
+
+    /**
+     * Exceed the memory budget while the executor is busy and return everything written
+     */
+    std::string exceedMemoryBudget(BudgetPolicy policy) {
+        ExecutorProbe probe;
+        auto capture = std::make_shared<CapturingSink>();
+        {
+            Logger logger(MODE_FILE, DEBUG, ASYNC, "", "at", std::make_shared<LoggerExecutor>(1));
+            logger.addSink(std::make_shared<ProbeSink>(probe, 'a'));
+            logger.addSink(capture);
+            logger.setBudgetPolicy(policy);
+
+            probe.setOpen(false);
+            logger.debug("Blocking the executor");
+            probe.waitBlocked();
+            for (int i = 0; i < 500; i++) {
+                logger.debugf("budget message %d", i);
+            }
+
+            probe.setOpen(true);
+            logger.flush();
+        }
+
+        return capture->text;
+    }
+
+    /**
+     * Spill and drop the messages exceeding the memory budget
+     */
+    bool testMemoryBudget() {
+        LogMemoryBudget::setLimit(16 * 1024);
+        const std::string spilled = exceedMemoryBudget(BUDGET_SPILL);
+        const std::string dropped = exceedMemoryBudget(BUDGET_DROP);
+        LogMemoryBudget::setLimit(0);
+
+        // Spilled messages are written back in order
+        size_t pos = 0;
+        for (int i = 0; i < 500 && pos != std::string::npos; i++) {
+            pos = spilled.find("budget message " + std::to_string(i) + "\n", pos);
+        }
+
+        const size_t kept = countOf(dropped, "budget message ");
+        return check(pos != std::string::npos, "spilled messages are written in order") &&
+               check(countOf(spilled, "Dropped ") == 0, "no messages are dropped when spilling") &&
+               check(kept > 0 && kept < 500, "messages exceeding the budget are dropped") &&
+               check(dropped.find("Dropped " + std::to_string(500 - kept) +
+                                  " DEBUG messages because the memory budget was exhausted") != std::string::npos,
+                     "messages dropped because of the budget are reported");
+    }
+
+#ifndef _WIN32
+    /**
+     * Read everything written to a temporary file and close it
+     */
+    std::string readAndClose(FILE *file) {
+        std::string text(static_cast<size_t>(ftell(file)), '\0');
+        rewind(file);
+        if (!text.empty() && fread(&text[0], 1, text.size(), file) != text.size()) {
+            text.clear();
+        }
+
+        fclose(file);
+        return text;
+    }
+
+    /**
+     * Write through shared memory sinks and collect the messages in-process
+     */
+    bool testSharedMemory() {
+        const std::string name = "logger_test_" + std::to_string(getpid());
+        SharedMemoryCollector collector(name);
+        const auto collect = [&collector] {
+            FILE *out = tmpfile();
+            collector.poll(out);
+            return readAndClose(out);
+        };
+
+        const auto segments = [&name] {
+            int count = 0;
+            DIR *dir = opendir("/dev/shm");
+            if (dir == nullptr) return count;
+
+            while (dirent *entry = readdir(dir)) {
+                count += std::string(entry->d_name).compare(0, name.size() + 1, name + ".") == 0 ? 1 : 0;
+            }
+
+            closedir(dir);
+            return count;
+        };
+
+        {
+            SharedMemorySink first(name), second(name);
+            first.write(DEBUG, "", 0, "first 1\n");
+            second.write(DEBUG, "", 0, "second 1\n");
+            first.write(DEBUG, "", 0, "first 2\n");
+            second.write(DEBUG, "", 0, "second 2\n");
+            if (!check(collect() == "first 1\nsecond 1\nfirst 2\nsecond 2\n", "shared memory record order")) {
+                return false;
+            }
+
+            // A full ring drops messages and the collector reports them
+            SharedMemorySink small(name, 4096);
+            const std::string message = std::string(100, 'x') + "\n";
+            for (int i = 0; i < 100; i++) {
+                small.write(DEBUG, "", 0, message);
+            }
+
+            const size_t dropped = small.droppedMessages();
+            std::string text = collect();
+            if (!check(dropped > 0, "shared memory drops") ||
+                !check(text.find("dropped " + std::to_string(dropped) + " messages") != std::string::npos,
+                       "shared memory drop report")) {
+                return false;
+            }
+
+            // The ring is almost full, the next messages wrap around after a padding record
+            for (int i = 0; i < 30; i++) {
+                small.write(DEBUG, "", 0, message);
+            }
+
+            text = collect();
+            const size_t written = 30 - (small.droppedMessages() - dropped);
+            if (!check(text.compare(0, written * message.size(), [&] {
+                std::string expected;
+                for (size_t i = 0; i < written; i++) expected += message;
+                return expected;
+            }()) == 0, "shared memory wrap around")) {
+                return false;
+            }
+
+            first.write(DEBUG, "", 0, "pending\n");
+        }
+
+        // Empty rings are removed by their sinks, the others once they have been drained
+        return check(segments() == 1, "shared memory segments of closed sinks") &&
+               check(collect() == "pending\n", "shared memory pending message") &&
+               check(segments() == 0, "shared memory segments after collecting");
+    }
+
+    /**
+     * Write a file with a sidecar index and search it by level, time, call site and text
+     */
+    bool testLogQuery() {
+        const std::string fileName = "test_query.log";
+        const auto now = [] {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        };
+
+        // Without the level in the messages, only the index knows it
+        LoggerOptions::setLogFormat("%m%n");
+        int errorLine;
+        int64_t later;
+        {
+            DirectFileOptions options;
+            options.append = false;
+            options.indexBlockSize = 64;
+
+            Logger logger(MODE_FILE, DEBUG, SYNC, "");
+            logger.addSink(std::make_shared<DirectFileSink>(fileName, options));
+            logger.debug("early debug looking like an [ERROR]");
+            errorLine = __LINE__ + 1;
+            logger.error("early error");
+            logger.warning("early warning");
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            later = now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            logger.debug("later debug");
+            logger.error("later error");
+        }
+        LoggerOptions::setLogFormat("[%t] [%f:%l] [%p] %m%n");
+
+        const auto query = [&fileName](const LogQueryOptions &options) {
+            FILE *out = tmpfile();
+            LogQuery(fileName, options).run(out);
+            return readAndClose(out);
+        };
+
+        LogQueryOptions errors;
+        errors.levels = 1u << ERROR;
+        LogQueryOptions warnings;
+        warnings.levels = (1u << ERROR) | (1u << WARNING);
+        LogQueryOptions pattern;
+        pattern.pattern = "debug";
+        LogQueryOptions from;
+        from.from = later;
+        LogQueryOptions to;
+        to.to = later;
+        LogQueryOptions site;
+        site.siteFile = LoggerUtils::removeSlash(__FILE__);
+        site.siteLine = errorLine;
+
+        return check(query(errors) == "early error\nlater error\n", "query by level") &&
+               check(query(warnings) == "early error\nearly warning\nlater error\n", "query by levels") &&
+               check(query(pattern) == "early debug looking like an [ERROR]\nlater debug\n", "query by text") &&
+               check(query(from) == "later debug\nlater error\nClosing logger\n", "query from a time") &&
+               check(query(to) == "early debug looking like an [ERROR]\nearly error\nearly warning\n",
+                     "query to a time") &&
+               check(query(site) == "early error\n", "query by call site");
+    }
+#endif
+}
+
 int main() {
     StaticLogger::create(MODE_CONSOLE, DEBUG, SYNC);
     StaticLogger::debug("Hello there");
@@ -43,5 +486,183 @@ int main() {
     StaticLogger::warning("Async mode");
     StaticLogger::error("Async mode");
 
+    {
+        Logger logger(MODE_CONSOLE, WARNING, SYNC);
+        logger.debugc("test.category", "Should not be displayed");
+        LogCategory::get("test").setLevel(DEBUG);
+        logger.debugc("test.category", "Should be displayed");
+        logger.debugcf("test.category", "Should be displayed: %d", 42);
+        LogCategory::get("test").resetLevel();
+        logger.debugc("test.category", "Should not be displayed");
+    }
+
+    {
+        Logger logger(MODE_CONSOLE, DEBUG, SYNC);
+        logger.setCoalesceRepeated(true);
+        for (int i = 0; i < 100; i++) {
+            logger.warning("Repeated message");
+        }
+    }
+
+    {
+        Logger logger(MODE_CONSOLE, DEBUG, ASYNC);
+        LoggerOptions::setLogFormat("[%t] [%N] [%p] %m {%X}%n");
+        LogContext::setThreadName("main");
+        LogContext::Scope scope("request", "42");
+        logger.debug("Message with context");
+        std::thread([&logger] {
+            logger.debug("Message without context");
+        }).join();
+    }
+    LoggerOptions::setLogFormat("[%t] [%f:%l] [%p] %m%n");
+
+    {
+        Logger logger(MODE_CONSOLE, DEBUG, ASYNC);
+        const char frame[] = "\x01\x02\x03Some binary frame\xff";
+        logger.debugPayload("Binary payload:", frame, sizeof(frame));
+        logger.debugPayload("Binary payload:", frame, sizeof(frame), PAYLOAD_BASE64);
+    }
+
+    {
+        // Payloads larger than one chunk must decode back to the original bytes
+        std::string payload(5000, '\0');
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] = static_cast<char>(i * 7 + i / 256);
+        }
+
+        auto sink = std::make_shared<CapturingSink>();
+        {
+            Logger logger(MODE_FILE, DEBUG, ASYNC, "");
+            logger.addSink(sink);
+            logger.debugPayload("Large payload:", payload.data(), payload.size(), PAYLOAD_BASE64);
+        }
+
+        std::string decoded;
+        if (!decodeBase64Lines(sink->text, decoded) || decoded != payload) {
+            std::cerr << "The base64 payload could not be decoded" << std::endl;
+            return 1;
+        }
+
+        sink->text.clear();
+        {
+            Logger logger(MODE_FILE, DEBUG, ASYNC, "");
+            logger.addSink(sink);
+            logger.debugPayload("Large payload:", payload.data(), payload.size());
+        }
+
+        // Every hex dump line must continue at the offset of the previous line
+        std::istringstream lines(sink->text);
+        size_t offset = 0;
+        for (std::string line; std::getline(lines, line);) {
+            if (line.compare(0, 4, "    ") != 0) continue;
+            if (std::stoul(line.substr(4, 8), nullptr, 16) != offset || (offset + 16 < payload.size() &&
+                                                                          line.size() != 82)) {
+                std::cerr << "Unexpected hex dump line: " << line << std::endl;
+                return 1;
+            }
+
+            offset += 16;
+        }
+
+        if (offset < payload.size()) {
+            std::cerr << "The hex dump is incomplete" << std::endl;
+            return 1;
+        }
+
+        std::cout << "Decoded a payload of " << decoded.size() << " bytes" << std::endl;
+    }
+
+    LogMemoryBudget::setLimit(1024 * 1024);
+    {
+        Logger logger(MODE_CONSOLE, DEBUG, ASYNC);
+        logger.setBudgetPolicy(BUDGET_SPILL);
+        logger.debug("Message within the memory budget");
+        logger.flush();
+        std::cout << "Memory used by queued messages: " << LogMemoryBudget::getUsage() << " bytes" << std::endl;
+    }
+    LogMemoryBudget::setLimit(0);
+
+    {
+        Logger logger(MODE_CONSOLE, DEBUG, ASYNC);
+        logger.setStackTraces(16);
+        logger.error("Exception with stack trace:", std::runtime_error("some error"));
+    }
+
+    {
+        Logger logger(MODE_CONSOLE, DEBUG, ASYNC);
+        logger.setTraceOutput("test_trace.json");
+        auto outer = logger.traceSpan("outer");
+        for (int i = 0; i < 10; i++) {
+            auto inner = logger.traceSpan("inner");
+            logger.debugf("Traced iteration %d", i);
+        }
+    }
+
+    if (!testSharedExecutor() || !testQueueCapacity() || !testMemoryBudget()) return 1;
+
+#ifndef _WIN32
+    {
+        DirectFileOptions options;
+        options.syncPolicy = DATASYNC_ON_FLUSH;
+
+        Logger logger(MODE_FILE, DEBUG, ASYNC, "");
+        logger.addSink(std::make_shared<DirectFileSink>("test_direct.log", options));
+        logger.setDurability(ERROR, DURABILITY_SYNC);
+        logger.debug("Direct file sink");
+        logger.errorf("Direct file sink: %d", 42);
+        logger.flush(true);
+    }
+
+    {
+        // A local agent listening on a datagram socket
+        const std::string path = "/tmp/logger_test_" + std::to_string(getpid()) + ".sock";
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        int agent = socket(AF_UNIX, SOCK_DGRAM, 0);
+        bind(agent, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+
+        SocketSinkOptions options;
+        options.syslog = true;
+        options.appName = "test";
+
+        {
+            Logger logger(MODE_FILE, DEBUG, ASYNC, "");
+            logger.addSink(std::make_shared<SocketSink>(path, options));
+            logger.debug("Socket sink");
+            logger.errorf("Socket sink: %d", 42);
+        }
+
+        char buf[1024];
+        ssize_t size;
+        while ((size = recv(agent, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            std::cout << "Agent received: " << std::string(buf, size) << std::endl;
+        }
+
+        close(agent);
+        unlink(path.c_str());
+    }
+
+    if (!testSharedMemory() || !testLogQuery()) return 1;
+#endif
+
+#ifdef LOGGER_ZLIB
+    {
+        CompressedFileOptions options;
+        options.append = false;
+        auto sink = std::make_shared<CompressedFileSink>("test_compressed.log.gz", options);
+
+        {
+            Logger logger(MODE_FILE, DEBUG, ASYNC, "");
+            logger.addSink(sink);
+            for (int i = 0; i < 1000; i++) {
+                logger.debugf("Compressed file sink: %d", i);
+            }
+        }
+
+        std::cout << "Compressed " << sink->bytesIn() << " bytes into " << sink->bytesOut() << " bytes" << std::endl;
+    }
+#endif
+
     return 0;
 }
@@ -0,0 +1,50 @@
+/*
+ * logger-collector
+ * Collects the messages written by all processes using a
+ * SharedMemorySink with the same name into a single output.
+ *
+ * Copyright (c) 2021 MarkusJx
+ * Licensed under the MIT License
+ */
+#include <iostream>
+#include <csignal>
+#include <logger.hpp>
+
+using namespace markusjx::logging;
+
+namespace {
+    std::atomic<bool> running(true);
+
+    void stop(int) {
+        running = false;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 3 || (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))) {
+        std::cerr << "Usage: " << argv[0] << " [name] [output file]" << std::endl;
+        return 1;
+    }
+
+    const std::string name = argc > 1 ? argv[1] : "logger";
+    FILE *out = stdout;
+    if (argc > 2) {
+        out = fopen(argv[2], "ab");
+        if (out == nullptr) {
+            perror("Could not open the output file");
+            return 1;
+        }
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    SharedMemoryCollector collector(name);
+    collector.run(out, running);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return 0;
+}
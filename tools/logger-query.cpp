@@ -0,0 +1,149 @@
+/*
+ * logger-query
+ * Searches a log file written by a DirectFileSink, using its
+ * sidecar index to only read the blocks which may contain matches.
+ *
+ * Copyright (c) 2021 MarkusJx
+ * Licensed under the MIT License
+ */
+#include <iostream>
+#include <ctime>
+#include <logger.hpp>
+
+using namespace markusjx::logging;
+
+namespace {
+    void usage(const char *name) {
+        std::cerr << "Usage: " << name << " [options] <log file>" << std::endl
+                  << "Options:" << std::endl
+                  << "  --from <time>       Only show messages written at or after this time" << std::endl
+                  << "  --to <time>         Only show messages written at or before this time" << std::endl
+                  << "  --level <level>     Only show messages of this level or above (ERROR, WARN, DEBUG)" << std::endl
+                  << "  --site <file:line>  Only show messages from this call site" << std::endl
+                  << "  --grep <text>       Only show messages containing this text" << std::endl
+                  << "  --index <file>      The index file to use. Defaults to <log file>.idx" << std::endl
+                  << "  --stats             Print the number of blocks and bytes scanned to stderr" << std::endl
+                  << "Times are local and may be given as 'YYYY-MM-DD HH:MM[:SS]', 'HH:MM[:SS]' (today)" << std::endl
+                  << "or as seconds since the epoch. They are the times the messages were written to the file," << std::endl
+                  << "which in ASYNC mode may be later than the times they were logged." << std::endl
+                  << "Levels, times and call sites are read from the index. Messages which are not indexed" << std::endl
+                  << "can only be searched using --grep." << std::endl;
+    }
+
+    bool parse_time(const char *str, int64_t &out) {
+        time_t now = time(nullptr);
+        struct tm tm{};
+        localtime_r(&now, &tm);
+        tm.tm_sec = 0;
+
+        const char *end = strptime(str, "%Y-%m-%d %H:%M", &tm);
+        if (end == nullptr) {
+            end = strptime(str, "%H:%M", &tm);
+        }
+
+        if (end != nullptr) {
+            if (*end == ':') {
+                end = strptime(end + 1, "%S", &tm);
+            }
+
+            if (end == nullptr || *end != '\0') return false;
+            tm.tm_isdst = -1;
+            out = static_cast<int64_t>(mktime(&tm)) * 1000;
+            return true;
+        }
+
+        char *numEnd = nullptr;
+        long long seconds = strtoll(str, &numEnd, 10);
+        if (numEnd == str || *numEnd != '\0') return false;
+        out = seconds * 1000;
+        return true;
+    }
+
+    bool parse_level(const std::string &str, uint32_t &out) {
+        if (str == "ERROR") {
+            out = 1u << ERROR;
+        } else if (str == "WARN" || str == "WARNING") {
+            out = (1u << ERROR) | (1u << WARNING);
+        } else if (str == "DEBUG") {
+            out = (1u << ERROR) | (1u << WARNING) | (1u << DEBUG);
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string logFile;
+    LogQueryOptions options;
+    bool stats = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--from" && hasValue) {
+            if (!parse_time(argv[++i], options.from)) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--to" && hasValue) {
+            if (!parse_time(argv[++i], options.to)) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+            // Include the whole second
+            options.to += 999;
+        } else if (arg == "--level" && hasValue) {
+            if (!parse_level(argv[++i], options.levels)) {
+                std::cerr << "Invalid log level: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--site" && hasValue) {
+            const std::string site(argv[++i]);
+            const size_t colon = site.rfind(':');
+            if (colon == std::string::npos) {
+                std::cerr << "Invalid call site: " << site << std::endl;
+                return 1;
+            }
+
+            options.siteFile = site.substr(0, colon);
+            options.siteLine = atoi(site.c_str() + colon + 1);
+        } else if (arg == "--grep" && hasValue) {
+            options.pattern = argv[++i];
+        } else if (arg == "--index" && hasValue) {
+            options.indexFile = argv[++i];
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg[0] != '-' && logFile.empty()) {
+            logFile = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (logFile.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    LogQuery query(logFile, options);
+    if (query.run(stdout) < 0) {
+        perror("Could not read the log file");
+        return 1;
+    }
+
+    const LogQueryStats &result = query.getStats();
+    if (result.skippedBytes > 0) {
+        std::cerr << result.skippedBytes << " bytes are not indexed and were skipped, "
+                  << "they can only be searched using --grep" << std::endl;
+    }
+
+    if (stats) {
+        std::cerr << "Scanned " << result.scannedBlocks << " of " << result.blocks << " indexed blocks, "
+                  << result.scannedBytes << " of " << result.fileSize << " bytes" << std::endl;
+    }
+
+    return 0;
+}